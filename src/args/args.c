@@ -28,10 +28,13 @@ SOFTWARE.
 #include "stdlib.h"
 #include "assert.h"
 #include "stdbool.h"
-#include "ctype.h"
+#include "strings.h"
 
 #include "args.h"
 #include "../help/help.h"
+#include "../effect/fade.h"
+#include "../shm/shm_ring.h"
+#include "../device/pacing.h"
 
 static int red;
 static int green;
@@ -41,30 +44,54 @@ static int vendor_id;
 static int product_id;
 
 static int version;
+static int force;
+static int cache;
 
-/**
- * @brief Converts the given ASCII string with given length to lower case.
- *
- * @param str The string to convert.
- * @param len The length of the string.
- */
-static void astrlow(char* str, size_t len)
-{
-    if (str == NULL)
-    {
-        return;
-    }
+static int socket_path;
 
-    if (len == 0)
-    {
-        return;
-    }
+static int transport;
 
-    for (size_t i = 0; i < len; i++)
-    {
-        str[i] = tolower(str[i]);
-    }
-}
+static int mock_latency;
+static int mock_fail_every;
+static int mock_error;
+
+static int record;
+static int replay;
+
+static int batch;
+
+static int log_level;
+
+static int stats;
+static int stats_file;
+
+static int fade;
+static int fade_from;
+static int fps;
+static int easing;
+
+static int react;
+static int input;
+static int bench;
+static int bench_limit;
+
+static int compile;
+static int output;
+static int profile;
+
+static int animate;
+static int encode_animation;
+static int video;
+static int shm;
+static int shm_name;
+
+static int target_latency;
+
+static int gamma_value;
+static int intensity;
+static int white_point;
+static int temperature;
+static int lut;
 
 /**
  * @brief Parses the lighting argument.
@@ -74,68 +101,147 @@ static void astrlow(char* str, size_t len)
  */
 static LMODE parse_lighting(char* lighting)
 {
-    if (lighting == NULL) {
+    LMODE mode = STATIC;
+
+    if (!lighting_mode_parse(lighting, &mode))
+    {
         return STATIC;
     }
 
-    astrlow(lighting, strlen(lighting));
+    return mode;
+}
 
-    if (strcmp(lighting, "wave") == 0)
+/**
+ * @brief Parses the transport argument.
+ *
+ * @param str Transport string.
+ * @return TRANSPORT_TYPE Corresponding transport. Unknown values select libusb.
+ */
+static TRANSPORT_TYPE parse_transport(const char* str)
+{
+    if (str != NULL && strcasecmp(str, "hidraw") == 0)
     {
-        return WAVE;
+        return TRANSPORT_HIDRAW;
     }
 
-    if (strcmp(lighting, "spectrum") == 0)
+    if (str != NULL && strcasecmp(str, "mock") == 0)
     {
-        return SPECTRUM;
+        return TRANSPORT_MOCK;
     }
 
-    if (strcmp(lighting, "breathing") == 0)
-    {
-        return BREATHING;
-    }
+    return TRANSPORT_LIBUSB;
+}
 
-    if (strcmp(lighting, "rolling") == 0)
-    {
-        return ROLLING;
-    }
+/**
+ * @brief Parses the error of failing mock transfers.
+ *
+ * @param str Error name.
+ * @return int Corresponding libusb error code. Unknown values select LIBUSB_ERROR_IO.
+ */
+static int parse_mock_error(const char* str)
+{
+    static const struct {
+        const char* name;
+        int error;
+    } errors[] = {
+        { "pipe", LIBUSB_ERROR_PIPE },
+        { "busy", LIBUSB_ERROR_BUSY },
+        { "no_device", LIBUSB_ERROR_NO_DEVICE },
+        { "timeout", LIBUSB_ERROR_TIMEOUT },
+    };
 
-    if (strcmp(lighting, "curve") == 0)
+    for (size_t i = 0; str != NULL && i < sizeof(errors) / sizeof(errors[0]); i++)
     {
-        return CURVE;
+        if (strcasecmp(str, errors[i].name) == 0)
+        {
+            return errors[i].error;
+        }
     }
 
-    if (strcmp(lighting, "scan") == 0)
+    return LIBUSB_ERROR_IO;
+}
+
+/**
+ * @brief Parses the log level argument.
+ *
+ * @param str Level name.
+ * @return LOG_LEVEL Corresponding level. Unknown values select LOG_LEVEL_INFO.
+ */
+static LOG_LEVEL parse_log_level(const char* str)
+{
+    LOG_LEVEL level = LOG_LEVEL_INFO;
+
+    if (!log_level_parse(str, &level))
     {
-        return SCAN;
+        return LOG_LEVEL_INFO;
     }
 
-    if (strcmp(lighting, "custom") == 0)
+    return level;
+}
+
+/**
+ * @brief Parses the statistics format argument.
+ *
+ * @param str Format name.
+ * @return STATS_FORMAT Corresponding format. Unknown values select STATS_FORMAT_JSON.
+ */
+static STATS_FORMAT parse_stats_format(const char* str)
+{
+    STATS_FORMAT format = STATS_FORMAT_JSON;
+
+    if (!stats_format_parse(str, &format))
     {
-        return CUSTOM;
+        return STATS_FORMAT_JSON;
     }
 
-    if (strcmp(lighting, "radiation") == 0)
+    return format;
+}
+
+/**
+ * @brief Parses a hexadecimal RRGGBB color.
+ *
+ * @param str Color string, optionally prefixed with #.
+ * @return int The color as 0xRRGGBB or -1 if invalid.
+ */
+static int parse_hex_color(const char* str)
+{
+    if (str == NULL)
     {
-        return RADIATION;
+        return -1;
     }
 
-    if (strcmp(lighting, "ripples") == 0)
+    if (str[0] == '#')
     {
-        return RIPPLES;
+        str++;
     }
 
-    if (strcmp(lighting, "single_key") == 0)
+    char* end = NULL;
+    long color = strtol(str, &end, 16);
+
+    if (end - str != 6 || *end != '\0' || color < 0)
     {
-        return SINGLE_KEY;
+        return -1;
     }
 
-    if (strcmp(lighting, "static") == 0)
+    return (int)color;
+}
+
+/**
+ * @brief Parses the easing argument.
+ *
+ * @param str Easing name.
+ * @return EASING Corresponding curve. Unknown values select EASING_IN_OUT.
+ */
+static EASING parse_easing(const char* str)
+{
+    EASING easing = EASING_IN_OUT;
+
+    if (!easing_parse(str, &easing))
     {
-        return STATIC;
+        return EASING_IN_OUT;
     }
 
-    return STATIC;
+    return easing;
 }
 
 void args_init(args_t* args)
@@ -158,7 +264,54 @@ void args_init(args_t* args)
     args->vendor_id = -1;
     args->product_id = -1;
 
+    args->transport = TRANSPORT_LIBUSB;
+
+    args->mock_latency_us = 0;
+    args->mock_fail_every = 0;
+    args->mock_error = LIBUSB_ERROR_IO;
+
+    args->log_level = LOG_LEVEL_INFO;
+
+    args->stats_format = STATS_FORMAT_NONE;
+    args->stats_path = NULL;
+
+    args->record_path = NULL;
+    args->replay_path = NULL;
+
+    args->batch_path = NULL;
+
     args->verbose = 0;
+
+    args->daemon = false;
+    args->watch = false;
+    args->all = false;
+    args->force = false;
+    args->cache = false;
+
+    args->fade_ms = 0;
+    args->fade_from = -1;
+    args->fps = FADE_DEFAULT_FPS;
+    args->easing = EASING_IN_OUT;
+
+    args->react = NULL;
+    args->input_path = NULL;
+    args->bench = false;
+    args->bench_limit_us = 0;
+
+    args->compile_path = NULL;
+    args->output_path = NULL;
+    args->profile = NULL;
+
+    args->animation_path = NULL;
+    args->encode_path = NULL;
+    args->video_path = NULL;
+    args->shm = false;
+    args->shm_name = SHM_RING_NAME;
+
+    args->target_latency_us = PACING_DEFAULT_TARGET_US;
+
+    correction_init(&args->correction);
+    args->socket_path = NULL;
 }
 
 static u_int8_t parse_color_value(const char* colorval)
@@ -193,7 +346,7 @@ void args_parse(int argc, char** argv, args_t* args)
         exit(EXIT_SUCCESS);
     }
 
-    static const char* shortopts = "vl:s:b:rd:";
+    static const char* shortopts = "vl:s:b:rd:Dwa";
     static struct option longopts[] = {
         {"red", required_argument, &red, 0},
         {"green", required_argument, &green, 0},
@@ -206,6 +359,44 @@ void args_parse(int argc, char** argv, args_t* args)
         {"product-id", required_argument, &product_id, 0},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, &version, 0},
+        {"force", no_argument, &force, 0},
+        {"cache", no_argument, &cache, 0},
+        {"daemon", no_argument, 0, 'D'},
+        {"watch", no_argument, 0, 'w'},
+        {"all", no_argument, 0, 'a'},
+        {"socket", required_argument, &socket_path, 0},
+        {"transport", required_argument, &transport, 0},
+        {"mock-latency", required_argument, &mock_latency, 0},
+        {"mock-fail-every", required_argument, &mock_fail_every, 0},
+        {"mock-error", required_argument, &mock_error, 0},
+        {"log-level", required_argument, &log_level, 0},
+        {"stats", required_argument, &stats, 0},
+        {"fade", required_argument, &fade, 0},
+        {"from", required_argument, &fade_from, 0},
+        {"fps", required_argument, &fps, 0},
+        {"easing", required_argument, &easing, 0},
+        {"react", required_argument, &react, 0},
+        {"input", required_argument, &input, 0},
+        {"bench", no_argument, &bench, 0},
+        {"bench-limit", required_argument, &bench_limit, 0},
+        {"compile", required_argument, &compile, 0},
+        {"output", required_argument, &output, 0},
+        {"profile", required_argument, &profile, 0},
+        {"animate", required_argument, &animate, 0},
+        {"encode-animation", required_argument, &encode_animation, 0},
+        {"video", required_argument, &video, 0},
+        {"shm", no_argument, &shm, 0},
+        {"shm-name", required_argument, &shm_name, 0},
+        {"target-latency", required_argument, &target_latency, 0},
+        {"gamma", required_argument, &gamma_value, 0},
+        {"intensity", required_argument, &intensity, 0},
+        {"white-point", required_argument, &white_point, 0},
+        {"temperature", required_argument, &temperature, 0},
+        {"lut", required_argument, &lut, 0},
+        {"stats-file", required_argument, &stats_file, 0},
+        {"record", required_argument, &record, 0},
+        {"replay", required_argument, &replay, 0},
+        {"batch", required_argument, &batch, 0},
         {0,         0,                 0,  0 }
     };
 
@@ -247,6 +438,245 @@ void args_parse(int argc, char** argv, args_t* args)
                 break;
             }
 
+            if (strcmp(longopts[option_index].name, "socket") == 0)
+            {
+                args->socket_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "transport") == 0)
+            {
+                args->transport = parse_transport(optarg);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "mock-latency") == 0)
+            {
+                args->mock_latency_us = strtoul(optarg, NULL, 10);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "mock-fail-every") == 0)
+            {
+                args->mock_fail_every = strtoul(optarg, NULL, 10);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "mock-error") == 0)
+            {
+                args->mock_error = parse_mock_error(optarg);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "log-level") == 0)
+            {
+                args->log_level = parse_log_level(optarg);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "fade") == 0)
+            {
+                args->fade_ms = strtoul(optarg, NULL, 10);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "from") == 0)
+            {
+                args->fade_from = parse_hex_color(optarg);
+
+                if (args->fade_from < 0)
+                {
+                    log_error("Invalid color %s, expected RRGGBB - Abort.", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "fps") == 0)
+            {
+                args->fps = strtoul(optarg, NULL, 10);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "easing") == 0)
+            {
+                args->easing = parse_easing(optarg);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "react") == 0)
+            {
+                args->react = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "input") == 0)
+            {
+                args->input_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "bench") == 0)
+            {
+                args->bench = true;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "bench-limit") == 0)
+            {
+                args->bench_limit_us = strtoul(optarg, NULL, 10);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "compile") == 0)
+            {
+                args->compile_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "output") == 0)
+            {
+                args->output_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "profile") == 0)
+            {
+                args->profile = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "animate") == 0)
+            {
+                args->animation_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "encode-animation") == 0)
+            {
+                args->encode_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "video") == 0)
+            {
+                args->video_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "shm") == 0)
+            {
+                args->shm = true;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "shm-name") == 0)
+            {
+                args->shm_name = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "target-latency") == 0)
+            {
+                args->target_latency_us = strtoul(optarg, NULL, 10);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "gamma") == 0)
+            {
+                args->correction.gamma = strtof(optarg, NULL);
+
+                if (args->correction.gamma <= 0)
+                {
+                    args->correction.gamma = 1;
+                }
+
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "intensity") == 0)
+            {
+                int percent = atoi(optarg);
+                args->correction.intensity = (percent < 0 ? 0 : percent > 100 ? 100 : percent) / 100.0f;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "white-point") == 0)
+            {
+                int white = parse_hex_color(optarg);
+
+                if (white < 0)
+                {
+                    log_error("Invalid color %s, expected RRGGBB - Abort.", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                args->correction.gain[0] *= ((white >> 16) & 0xff) / 255.0f;
+                args->correction.gain[1] *= ((white >> 8) & 0xff) / 255.0f;
+                args->correction.gain[2] *= (white & 0xff) / 255.0f;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "temperature") == 0)
+            {
+                correction_set_temperature(&args->correction, strtoul(optarg, NULL, 10));
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "lut") == 0)
+            {
+                if (!correction_load_cube(&args->correction, optarg))
+                {
+                    log_error("Error loading 3D LUT %s - Abort.", optarg);
+                    exit(EXIT_FAILURE);
+                }
+
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "stats") == 0)
+            {
+                args->stats_format = parse_stats_format(optarg);
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "stats-file") == 0)
+            {
+                args->stats_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "record") == 0)
+            {
+                args->record_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "replay") == 0)
+            {
+                args->replay_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "batch") == 0)
+            {
+                args->batch_path = optarg;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "force") == 0)
+            {
+                args->force = true;
+                break;
+            }
+
+            if (strcmp(longopts[option_index].name, "cache") == 0)
+            {
+                args->cache = true;
+                break;
+            }
+
             if (strcmp(longopts[option_index].name, "version") == 0)
             {
                 version_print();
@@ -290,10 +720,40 @@ void args_parse(int argc, char** argv, args_t* args)
             args->random_colors = true;
             break;
 
+        case 'D':
+            args->daemon = true;
+            break;
+
+        case 'w':
+            args->watch = true;
+            break;
+
+        case 'a':
+            args->all = true;
+            break;
+
         case '?':
             help_print();
             exit(EXIT_FAILURE);
 
         }
     }
+
+    correction_prepare(&args->correction);
+}
+
+void args_to_lighting(args_t* args, lighting_t* lighting)
+{
+    assert(args != NULL);
+    assert(lighting != NULL);
+
+    lighting_init(lighting);
+
+    lighting->red = args->red;
+    lighting->green = args->green;
+    lighting->blue = args->blue;
+    lighting->mode = args->lighting;
+    lighting->speed = args->speed;
+    lighting->brightness = args->brightness;
+    lighting->random_colors = args->random_colors;
 }
@@ -27,6 +27,11 @@ SOFTWARE.
 #include "stdint.h"
 
 #include "../device/lighting.h"
+#include "../device/transport.h"
+#include "../log/log.h"
+#include "../stats/stats.h"
+#include "../effect/easing.h"
+#include "../color/correction.h"
 
 /**
  * @brief Defines the application arguments.
@@ -87,11 +92,181 @@ typedef struct {
      */
     int product_id;
 
+    /**
+     * @brief Defines how reports are sent to the device.
+     */
+    TRANSPORT_TYPE transport;
+
+    /**
+     * @brief Simulated transfer duration of the mock transport in microseconds.
+     */
+    unsigned int mock_latency_us;
+
+    /**
+     * @brief Every n-th transfer of the mock transport fails. 0 disables errors.
+     */
+    unsigned int mock_fail_every;
+
+    /**
+     * @brief Error code of failing mock transfers.
+     */
+    int mock_error;
+
+    /**
+     * @brief Minimum level of log messages to print.
+     */
+    LOG_LEVEL log_level;
+
+    /**
+     * @brief Export format of the timing statistics written at exit.
+     */
+    STATS_FORMAT stats_format;
+
+    /**
+     * @brief File the statistics are written to. NULL for stdout.
+     */
+    char* stats_path;
+
+    /**
+     * @brief If set all sent reports are recorded to this file.
+     */
+    char* record_path;
+
+    /**
+     * @brief If set the reports of this recording are sent instead of the lighting.
+     */
+    char* replay_path;
+
+    /**
+     * @brief If set the commands of this file are executed instead of setting the lighting. "-" reads stdin.
+     */
+    char* batch_path;
+
     /**
      * @brief Defines if the application should be run in verbose mode.
      */
     bool verbose;
 
+    /**
+     * @brief Defines if the application should run as lighting daemon.
+     */
+    bool daemon;
+
+    /**
+     * @brief Defines if the lighting shall be applied to all matching devices instead of asking for one.
+     */
+    bool all;
+
+    /**
+     * @brief Defines if the lighting shall be sent even if the device is known to show it already.
+     */
+    bool force;
+
+    /**
+     * @brief Defines if the lighting shall be skipped if the cache shows that the device already has it.
+     */
+    bool cache;
+
+    /**
+     * @brief Duration of the fade to the lighting in milliseconds. 0 applies the lighting immediately.
+     */
+    unsigned int fade_ms;
+
+    /**
+     * @brief Color the fade starts at as 0xRRGGBB. -1 starts at the last applied color.
+     */
+    int fade_from;
+
+    /**
+     * @brief Frames per second of the fade.
+     */
+    unsigned int fps;
+
+    /**
+     * @brief Progress curve of the fade.
+     */
+    EASING easing;
+
+    /**
+     * @brief Reactive effect rendered on key presses, see reactive_run. NULL if not set.
+     */
+    char* react;
+
+    /**
+     * @brief Event device or recording of key events for the reactive mode. NULL uses the keyboard.
+     */
+    char* input_path;
+
+    /**
+     * @brief Defines if the key to LED latency shall be benchmarked against the mock device.
+     */
+    bool bench;
+
+    /**
+     * @brief The benchmark fails if the 99th percentile of the latency exceeds this many microseconds. 0 disables.
+     */
+    unsigned int bench_limit_us;
+
+    /**
+     * @brief Profile source to compile, see profile_compile_run. NULL if not set.
+     */
+    char* compile_path;
+
+    /**
+     * @brief Path of the compiled profile. NULL stores it in the profile directory.
+     */
+    char* output_path;
+
+    /**
+     * @brief Name or path of the compiled profile to apply, see profile_apply_run. NULL if not set.
+     */
+    char* profile;
+
+    /**
+     * @brief Animation file to play, see animation_play_run. NULL if not set.
+     */
+    char* animation_path;
+
+    /**
+     * @brief Animation source to encode, see animation_encode_run. NULL if not set.
+     */
+    char* encode_path;
+
+    /**
+     * @brief YUV4MPEG2 stream to show, see video_run. "-" reads stdin, NULL if not set.
+     */
+    char* video_path;
+
+    /**
+     * @brief Defines if frames shall be taken from the shared memory ring, see shm_run.
+     */
+    bool shm;
+
+    /**
+     * @brief Name of the shared memory ring.
+     */
+    const char* shm_name;
+
+    /**
+     * @brief Time uploading a frame of a streamed effect may take in microseconds, see pacing_t. 0 disables pacing.
+     */
+    unsigned int target_latency_us;
+
+    /**
+     * @brief Color correction applied to all colors sent to the device.
+     */
+    correction_t correction;
+
+    /**
+     * @brief Defines if the lighting shall be reapplied whenever a matching device arrives.
+     */
+    bool watch;
+
+    /**
+     * @brief Explicit path of the daemon socket. NULL if the default path shall be used.
+     */
+    char* socket_path;
+
 } args_t;
 
 /**
@@ -109,3 +284,11 @@ void args_init(args_t* args);
  * @param args Pointer to args_t struct holding the argument values.
  */
 void args_parse(int argc, char** argv, args_t* args);
+
+/**
+ * @brief Fills the given lighting with the lighting related values of args.
+ *
+ * @param args Application arguments.
+ * @param lighting Holds information about lighting.
+ */
+void args_to_lighting(args_t* args, lighting_t* lighting);
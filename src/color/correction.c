@@ -0,0 +1,355 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+
+#include "correction.h"
+
+#define LANES 4 // Keys corrected at once by the LUT kernel, one SSE/NEON register
+
+typedef float v4f __attribute__((vector_size(LANES * sizeof(float))));
+typedef int32_t v4i __attribute__((vector_size(LANES * sizeof(int32_t))));
+
+void correction_init(correction_t* correction)
+{
+    memset(correction, 0, sizeof(correction_t));
+
+    correction->gamma = 1;
+    correction->intensity = 1;
+    correction->gain[0] = correction->gain[1] = correction->gain[2] = 1;
+
+    correction_prepare(correction);
+}
+
+/**
+ * @brief FNV-1a over the given bytes.
+ */
+static uint32_t hash(uint32_t h, const void* data, size_t len)
+{
+    const uint8_t* bytes = data;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ bytes[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+void correction_prepare(correction_t* correction)
+{
+    for (int c = 0; c < 3; c++)
+    {
+        float gain = correction->gain[c] * correction->intensity;
+
+        for (int i = 0; i < 256; i++)
+        {
+            float v = powf(i / 255.0f, correction->gamma) * gain;
+            v = v < 0 ? 0 : v > 1 ? 1 : v;
+
+            correction->curve[c][i] = (uint8_t)lroundf(v * 255);
+        }
+    }
+
+    correction->enabled = correction->lut.data != NULL;
+    for (int c = 0; c < 3 && !correction->enabled; c++)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            if (correction->curve[c][i] != i)
+            {
+                correction->enabled = true;
+                break;
+            }
+        }
+    }
+
+    uint32_t h = hash(2166136261u, correction->curve, sizeof(correction->curve));
+
+    if (correction->lut.data != NULL)
+    {
+        size_t entries = (size_t)correction->lut.size * correction->lut.size * correction->lut.size;
+        h = hash(h, correction->lut.data, entries * 3 * sizeof(float));
+    }
+
+    correction->id = h;
+}
+
+void correction_set_temperature(correction_t* correction, unsigned int kelvin)
+{
+    // Approximation of the blackbody color by Tanner Helland, normalized so 6500 K is neutral.
+    float rgb[2][3];
+    unsigned int temps[2] = { kelvin, 6500 };
+
+    for (int t = 0; t < 2; t++)
+    {
+        float k = (temps[t] < 1000 ? 1000 : temps[t] > 40000 ? 40000 : temps[t]) / 100.0f;
+
+        rgb[t][0] = k <= 66 ? 255 : 329.698727446f * powf(k - 60, -0.1332047592f);
+        rgb[t][1] = k <= 66 ? 99.4708025861f * logf(k) - 161.1195681661f : 288.1221695283f * powf(k - 60, -0.0755148492f);
+        rgb[t][2] = k >= 66 ? 255 : k <= 19 ? 0 : 138.5177312231f * logf(k - 10) - 305.0447927307f;
+
+        for (int c = 0; c < 3; c++)
+        {
+            rgb[t][c] = rgb[t][c] < 0 ? 0 : rgb[t][c] > 255 ? 255 : rgb[t][c];
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        correction->gain[c] *= rgb[0][c] / rgb[1][c];
+    }
+}
+
+bool correction_load_cube(correction_t* correction, const char* path)
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    int size = 0;
+    size_t count = 0;
+    size_t entries = 0;
+    float* data = NULL;
+    bool valid = true;
+
+    char line[256];
+    while (valid && fgets(line, sizeof(line), file) != NULL)
+    {
+        char* p = line + strspn(line, " \t");
+
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+        {
+            continue;
+        }
+
+        if (strncmp(p, "LUT_3D_SIZE", 11) == 0)
+        {
+            size = atoi(p + 11);
+            valid = data == NULL && size >= 2 && size <= CORRECTION_LUT_MAX_SIZE;
+
+            if (valid)
+            {
+                entries = (size_t)size * size * size;
+                data = malloc(entries * 3 * sizeof(float));
+                valid = data != NULL;
+            }
+
+            continue;
+        }
+
+        // TITLE, DOMAIN_MIN, DOMAIN_MAX etc. The default domain 0 to 1 is assumed.
+        if ((*p >= 'A' && *p <= 'Z') || *p == '_')
+        {
+            continue;
+        }
+
+        float r, g, b;
+        if (data == NULL || count >= entries || sscanf(p, "%f %f %f", &r, &g, &b) != 3)
+        {
+            valid = false;
+            break;
+        }
+
+        data[count * 3 + 0] = r;
+        data[count * 3 + 1] = g;
+        data[count * 3 + 2] = b;
+        count++;
+    }
+
+    fclose(file);
+
+    if (!valid || data == NULL || count != entries)
+    {
+        free(data);
+        return false;
+    }
+
+    free(correction->lut.data);
+    correction->lut.size = size;
+    correction->lut.data = data;
+
+    return true;
+}
+
+void correction_free(correction_t* correction)
+{
+    free(correction->lut.data);
+    correction->lut.data = NULL;
+    correction->lut.size = 0;
+}
+
+/**
+ * @brief Lane wise selection, a where mask is set and b otherwise.
+ */
+static inline v4f lane_select(v4i mask, v4f a, v4f b)
+{
+    return (v4f)(((v4i)a & mask) | ((v4i)b & ~mask));
+}
+
+/**
+ * @brief Reads one channel of the LUT entries at the given indices.
+ */
+static v4f gather(const float* data, v4i index, int channel)
+{
+    v4f v;
+
+    for (int i = 0; i < LANES; i++)
+    {
+        v[i] = data[index[i] * 3 + channel];
+    }
+
+    return v;
+}
+
+/**
+ * @brief Applies the LUT to LANES colors with trilinear interpolation.
+ *
+ * @param lut The LUT.
+ * @param rgb The channels of the colors from 0 to 255. Receive the result.
+ */
+static void lut_kernel(const lut3d_t* lut, v4f rgb[3])
+{
+    const int n = lut->size;
+    const float scale = (n - 1) / 255.0f;
+
+    v4i base[3];
+    v4f frac[3];
+
+    for (int c = 0; c < 3; c++)
+    {
+        v4f pos = rgb[c] * scale;
+        v4i i = __builtin_convertvector(pos, v4i);
+
+        // The upper edge uses the last cell with a fraction of 1.
+        v4i last = (v4i){ 0 } + (n - 2);
+        v4i over = i > last;
+        i = (i & ~over) | (last & over);
+
+        base[c] = i;
+        frac[c] = pos - __builtin_convertvector(i, v4f);
+    }
+
+    v4i idx = base[0] + base[1] * n + base[2] * n * n;
+    const int dx = 1, dy = n, dz = n * n;
+
+    for (int c = 0; c < 3; c++)
+    {
+        v4f c000 = gather(lut->data, idx, c);
+        v4f c100 = gather(lut->data, idx + dx, c);
+        v4f c010 = gather(lut->data, idx + dy, c);
+        v4f c110 = gather(lut->data, idx + dx + dy, c);
+        v4f c001 = gather(lut->data, idx + dz, c);
+        v4f c101 = gather(lut->data, idx + dx + dz, c);
+        v4f c011 = gather(lut->data, idx + dy + dz, c);
+        v4f c111 = gather(lut->data, idx + dx + dy + dz, c);
+
+        v4f c00 = c000 + (c100 - c000) * frac[0];
+        v4f c10 = c010 + (c110 - c010) * frac[0];
+        v4f c01 = c001 + (c101 - c001) * frac[0];
+        v4f c11 = c011 + (c111 - c011) * frac[0];
+
+        v4f c0 = c00 + (c10 - c00) * frac[1];
+        v4f c1 = c01 + (c11 - c01) * frac[1];
+
+        v4f v = (c0 + (c1 - c0) * frac[2]) * 255.0f + 0.5f;
+
+        v = lane_select(v < 0, (v4f){ 0 }, v);
+        v = lane_select(v > 255.0f, (v4f){ 0 } + 255.0f, v);
+
+        rgb[c] = v;
+    }
+}
+
+/**
+ * @brief Corrects count colors in place.
+ */
+static void apply_colors(const correction_t* correction, rgb_t* colors, int count)
+{
+    // Per channel curves cover gamma, intensity and white point.
+    for (int i = 0; i < count; i++)
+    {
+        colors[i].red = correction->curve[0][colors[i].red];
+        colors[i].green = correction->curve[1][colors[i].green];
+        colors[i].blue = correction->curve[2][colors[i].blue];
+    }
+
+    if (correction->lut.data == NULL)
+    {
+        return;
+    }
+
+    for (int start = 0; start < count; start += LANES)
+    {
+        int lanes = count - start < LANES ? count - start : LANES;
+
+        v4f rgb[3] = { { 0 }, { 0 }, { 0 } };
+
+        for (int i = 0; i < lanes; i++)
+        {
+            rgb[0][i] = colors[start + i].red;
+            rgb[1][i] = colors[start + i].green;
+            rgb[2][i] = colors[start + i].blue;
+        }
+
+        lut_kernel(&correction->lut, rgb);
+
+        for (int i = 0; i < lanes; i++)
+        {
+            colors[start + i].red = (uint8_t)rgb[0][i];
+            colors[start + i].green = (uint8_t)rgb[1][i];
+            colors[start + i].blue = (uint8_t)rgb[2][i];
+        }
+    }
+}
+
+rgb_t correction_apply(const correction_t* correction, rgb_t color)
+{
+    if (correction == NULL || !correction->enabled)
+    {
+        return color;
+    }
+
+    apply_colors(correction, &color, 1);
+    return color;
+}
+
+void correction_apply_frame(const correction_t* correction, const frame_t* in, frame_t* out)
+{
+    if (out != in)
+    {
+        memcpy(out, in, sizeof(frame_t));
+    }
+
+    if (correction == NULL || !correction->enabled)
+    {
+        return;
+    }
+
+    apply_colors(correction, out->keys, FRAME_KEYS);
+}
@@ -0,0 +1,149 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#include "../device/frame.h"
+
+#define CORRECTION_LUT_MAX_SIZE 65 // Largest supported edge length of a 3D LUT
+
+/**
+ * @brief 3D lookup table as read from a .cube file.
+ */
+typedef struct
+{
+    /**
+     * @brief Number of entries per axis.
+     */
+    int size;
+
+    /**
+     * @brief size^3 RGB triplets from 0 to 1, red changing fastest.
+     */
+    float* data;
+
+} lut3d_t;
+
+/**
+ * @brief Color correction applied to all colors before they are sent to the device.
+ *
+ * Gamma, intensity and white point only depend on one channel each and are folded into one curve per channel by
+ * correction_prepare. The optional 3D LUT is applied afterwards.
+ */
+typedef struct correction
+{
+    /**
+     * @brief Exponent applied to the normalized channels. 1 leaves the colors unchanged.
+     */
+    float gamma;
+
+    /**
+     * @brief Scales all channels, 0 to 1.
+     */
+    float intensity;
+
+    /**
+     * @brief Gain per channel, i.e. from the white point or color temperature.
+     */
+    float gain[3];
+
+    /**
+     * @brief Optional calibration LUT. data is NULL if not used.
+     */
+    lut3d_t lut;
+
+    /**
+     * @brief Resulting curve per channel, see correction_prepare.
+     */
+    uint8_t curve[3][256];
+
+    /**
+     * @brief Defines if any correction is configured.
+     */
+    bool enabled;
+
+    /**
+     * @brief Hash of all parameters, so results can be cached per configuration.
+     */
+    uint32_t id;
+
+} correction_t;
+
+/**
+ * @brief Initializes the correction to leave colors unchanged.
+ *
+ * @param correction The correction.
+ */
+void correction_init(correction_t* correction);
+
+/**
+ * @brief Computes the curves and id after the parameters were changed.
+ *
+ * @param correction The correction.
+ */
+void correction_prepare(correction_t* correction);
+
+/**
+ * @brief Multiplies the gains with the white balance of the given color temperature, relative to 6500 K.
+ *
+ * @param correction The correction.
+ * @param kelvin Color temperature from 1000 to 40000 K.
+ */
+void correction_set_temperature(correction_t* correction, unsigned int kelvin);
+
+/**
+ * @brief Loads a 3D LUT in the .cube format.
+ *
+ * @param correction The correction.
+ * @param path Path of the .cube file.
+ * @return true The LUT was loaded.
+ * @return false The file could not be read or is invalid.
+ */
+bool correction_load_cube(correction_t* correction, const char* path);
+
+/**
+ * @brief Frees the LUT of the correction.
+ *
+ * @param correction The correction.
+ */
+void correction_free(correction_t* correction);
+
+/**
+ * @brief Corrects a single color.
+ *
+ * @param correction The correction.
+ * @param color The color.
+ * @return rgb_t The corrected color.
+ */
+rgb_t correction_apply(const correction_t* correction, rgb_t color);
+
+/**
+ * @brief Corrects all keys of a frame.
+ *
+ * @param correction The correction.
+ * @param in The frame to correct.
+ * @param out Receives the corrected frame. May be the same as in.
+ */
+void correction_apply_frame(const correction_t* correction, const frame_t* in, frame_t* out);
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+
+#include "batch.h"
+#include "command.h"
+#include "../log/log.h"
+
+int batch_run(args_t* args)
+{
+    FILE* file = stdin;
+
+    if (strcmp(args->batch_path, "-") != 0)
+    {
+        file = fopen(args->batch_path, "r");
+
+        if (file == NULL)
+        {
+            log_error("Error opening %s - %s - Abort.\n", args->batch_path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    command_session_t session;
+    command_session_init(&session, &transport);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char* line = NULL;
+    size_t len = 0;
+    int lineno = 0;
+    int failed = 0;
+
+    while (getline(&line, &len, file) != -1)
+    {
+        lineno++;
+
+        int ret = command_execute(&session, line);
+
+        if (ret == LIBUSB_ERROR_INVALID_PARAM)
+        {
+            log_error("Invalid command in line %i: %s", lineno, strtok(line, "\r\n"));
+            failed++;
+        }
+        else if (ret == LIBUSB_ERROR_NOT_SUPPORTED)
+        {
+            log_error("Line %i: Per key colors need CUSTOM lighting", lineno);
+            failed++;
+        }
+        else if (ret < LIBUSB_SUCCESS)
+        {
+            failed++;
+        }
+    }
+
+    free(line);
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (args->verbose)
+    {
+        log_info("Executed %i lines (%i failed) in %.1f ms", lineno, failed,
+            (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    }
+
+    device_disconnect(&transport);
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
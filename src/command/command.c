@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+#include "assert.h"
+
+#include "command.h"
+
+/**
+ * @brief Applies per key colors. The keys that are not mentioned keep their color.
+ *
+ * @param session The session.
+ * @param keys Key assignments, see frame_parse_keys.
+ * @return int Number of bytes written or a libusb error code.
+ */
+static int apply_keys(command_session_t* session, const char* keys)
+{
+    if (!session->custom_active)
+    {
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+
+    frame_t next = session->frame;
+
+    if (!frame_parse_keys(keys, &next))
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+
+    session->frame = next;
+
+    return device_custom_frame(&session->frame, &session->frame_state, session->transport);
+}
+
+/**
+ * @brief Applies a lighting command.
+ *
+ * @param session The session.
+ * @param lighting Holds information about lighting.
+ * @return int Number of bytes written or a libusb error code.
+ */
+static int apply_lighting(command_session_t* session, lighting_t lighting)
+{
+    int ret = device_apply_lighting(lighting, session->transport);
+
+    // The lighting of a lost device is pending and applied once the device is back, see device_recover_step.
+    bool pending = ret < LIBUSB_SUCCESS && session->transport->lost;
+
+    session->custom_active = lighting.mode == CUSTOM && (ret >= LIBUSB_SUCCESS || pending);
+    session->frame_state.synced = session->custom_active && !pending;
+
+    if (session->custom_active)
+    {
+        rgb_t color = { lighting.red, lighting.green, lighting.blue };
+        frame_fill(&session->frame, color);
+        session->frame_state.shown = session->frame;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Waits for the given number of milliseconds.
+ *
+ * @param arg The milliseconds.
+ * @return int LIBUSB_SUCCESS or LIBUSB_ERROR_INVALID_PARAM.
+ */
+static int delay(const char* arg)
+{
+    char* end;
+    long ms = strtol(arg, &end, 10);
+
+    while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n')
+    {
+        end++;
+    }
+
+    if (end == arg || *end != '\0' || ms < 0)
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+    {
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+void command_session_init(command_session_t* session, transport_t* transport)
+{
+    assert(session != NULL);
+
+    session->transport = transport;
+    session->custom_active = false;
+
+    frame_init(&session->frame);
+    frame_state_init(&session->frame_state);
+}
+
+int command_execute(command_session_t* session, const char* line)
+{
+    assert(session != NULL);
+    assert(line != NULL);
+
+    line += strspn(line, " \t");
+
+    if (*line == '\0' || *line == '\n' || *line == '\r' || *line == '#')
+    {
+        return LIBUSB_SUCCESS;
+    }
+
+    if (strncmp(line, "key ", 4) == 0)
+    {
+        return apply_keys(session, line + 4);
+    }
+
+    if (strncmp(line, "delay ", 6) == 0)
+    {
+        return delay(line + 6);
+    }
+
+    lighting_t lighting;
+    lighting_init(&lighting);
+
+    if (!lighting_parse(line, &lighting))
+    {
+        return LIBUSB_ERROR_INVALID_PARAM;
+    }
+
+    return apply_lighting(session, lighting);
+}
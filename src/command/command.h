@@ -0,0 +1,68 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "../device/device.h"
+
+/**
+ * @brief State shared by consecutive commands on one opened device.
+ */
+typedef struct
+{
+    transport_t* transport;
+
+    /**
+     * @brief Per key colors of the last CUSTOM lighting and the frame shown by the device.
+     */
+    frame_t frame;
+    frame_state_t frame_state;
+
+    /**
+     * @brief True if the last applied lighting was CUSTOM.
+     */
+    bool custom_active;
+
+} command_session_t;
+
+/**
+ * @brief Initializes a session on the given device.
+ *
+ * @param session The session.
+ * @param transport The opened device.
+ */
+void command_session_init(command_session_t* session, transport_t* transport);
+
+/**
+ * @brief Executes a single command.
+ *
+ * Supported commands are lighting commands (see lighting_parse), "key INDEX=RRGGBB ..." to set
+ * per key colors in CUSTOM mode and "delay MS". Empty lines and lines starting with '#' are ignored.
+ *
+ * @param session The session.
+ * @param line The command.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_INVALID_PARAM for invalid commands, LIBUSB_ERROR_NOT_SUPPORTED
+ * for key commands outside of CUSTOM mode or the libusb error of the transfer.
+ */
+int command_execute(command_session_t* session, const char* line);
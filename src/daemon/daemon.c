@@ -0,0 +1,508 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE // accept4
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+
+#include "daemon.h"
+#include "../command/command.h"
+#include "../log/log.h"
+#include "../loop/loop.h"
+
+#define DAEMON_BACKLOG 8
+#define DAEMON_LINE_LEN 2048
+
+#define DAEMON_MAX_CLIENTS 8
+
+#define DAEMON_TRANSFER_TIMEOUT_MS 1000 // A stalled device must not block the loop
+
+/**
+ * @brief A connected client and its incomplete command.
+ */
+typedef struct
+{
+    int fd;
+    struct daemon* daemon;
+
+    char buf[DAEMON_LINE_LEN];
+    size_t filled;
+
+} client_t;
+
+/**
+ * @brief Fills the socket address of the daemon.
+ *
+ * Without --socket the socket is placed in XDG_RUNTIME_DIR, which only the user can access. There is no default in a
+ * shared directory like /tmp, where another user could bind the path first.
+ *
+ * @param args Application arguments.
+ * @param addr Receives the address.
+ * @return true If there is a path and it fits into the address.
+ */
+static bool socket_address(args_t* args, struct sockaddr_un* addr)
+{
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+
+    int len;
+    if (args->socket_path != NULL)
+    {
+        len = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", args->socket_path);
+    }
+    else
+    {
+        const char* dir = getenv("XDG_RUNTIME_DIR");
+
+        if (dir == NULL || *dir == '\0')
+        {
+            return false;
+        }
+
+        len = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%s", dir, DAEMON_SOCKET_NAME);
+    }
+
+    return len > 0 && len < sizeof(addr->sun_path);
+}
+
+/**
+ * @brief Connects to the daemon socket.
+ *
+ * @param addr Socket address.
+ * @return int The connected socket or -1.
+ */
+static int socket_connect(struct sockaddr_un* addr)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr*)addr, sizeof(struct sockaddr_un)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Creates the listening daemon socket. A stale socket file is removed, a running daemon aborts.
+ *
+ * @param addr Socket address.
+ * @return int The listening socket.
+ */
+static int socket_listen(struct sockaddr_un* addr)
+{
+    int other = socket_connect(addr);
+
+    if (other >= 0)
+    {
+        close(other);
+        log_error("Daemon already running on %s - Abort.\n", addr->sun_path);
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(addr->sun_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        log_error("Error creating socket - %s - Abort.\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (bind(fd, (struct sockaddr*)addr, sizeof(struct sockaddr_un)) < 0 || listen(fd, DAEMON_BACKLOG) < 0)
+    {
+        log_error("Error listening on %s - %s - Abort.\n", addr->sun_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Applies a single command line and sends the reply to the client.
+ *
+ * @param client Client socket.
+ * @param line The command, see command_execute.
+ * @param session The command session of the daemon.
+ * @return true The reply was sent. A client that does not read its replies is not waited for.
+ */
+static bool handle_command(int client, const char* line, command_session_t* session)
+{
+    char reply[DAEMON_LINE_LEN];
+
+    // Commands of all clients are applied on the thread of the event loop, which must not sleep.
+    bool delay = strncmp(line + strspn(line, " \t"), "delay ", 6) == 0;
+
+    int ret = delay ? LIBUSB_ERROR_NOT_SUPPORTED : command_execute(session, line);
+
+    if (delay)
+    {
+        snprintf(reply, sizeof(reply), "ERR delay not supported by the daemon\n");
+    }
+    else if (ret == LIBUSB_ERROR_INVALID_PARAM)
+    {
+        log_error("Invalid command: %s", line);
+        snprintf(reply, sizeof(reply), "ERR invalid command\n");
+    }
+    else if (ret == LIBUSB_ERROR_NOT_SUPPORTED)
+    {
+        snprintf(reply, sizeof(reply), "ERR custom mode not active\n");
+    }
+    else if (ret < LIBUSB_SUCCESS)
+    {
+        snprintf(reply, sizeof(reply), "ERR %s\n", libusb_error_name(ret));
+    }
+    else
+    {
+        snprintf(reply, sizeof(reply), "OK\n");
+    }
+
+    size_t len = strlen(reply);
+
+    return send(client, reply, len, MSG_NOSIGNAL | MSG_DONTWAIT) == len;
+}
+
+/**
+ * @brief Accepts clients and applies their commands, see daemon_run.
+ */
+typedef struct daemon
+{
+    command_session_t session;
+    client_t clients[DAEMON_MAX_CLIENTS];
+
+    /**
+     * @brief Fires when the next attempt to recover the lost device is due.
+     */
+    int recover_timer;
+    device_recovery_t recovery;
+    bool recovering;
+
+} daemon_t;
+
+/**
+ * @brief Schedules the recovery of the device if a command lost it. Commands received meanwhile are answered with an
+ * error, the lighting they set is applied once the device is back.
+ */
+static void watch_device(daemon_t* daemon)
+{
+    transport_t* transport = daemon->session.transport;
+
+    if (daemon->recovering || !transport->lost)
+    {
+        return;
+    }
+
+    if (device_recover_start(transport, LIBUSB_ERROR_NO_DEVICE, &daemon->recovery))
+    {
+        daemon->recovering = true;
+        loop_timer_set(daemon->recover_timer, daemon->recovery.delay_us * 1000ULL, 0);
+    }
+}
+
+/**
+ * @brief Tries to recover the device without blocking the loop.
+ */
+static void on_recover(loop_t* loop, int fd, uint32_t events, void* user)
+{
+    daemon_t* daemon = user;
+    transport_t* transport = daemon->session.transport;
+
+    loop_timer_read(fd);
+
+    // The per key colors of custom mode are sent on top of the pending lighting.
+    command_session_t* session = &daemon->session;
+    daemon->recovery.frame = session->custom_active ? &session->frame : NULL;
+    daemon->recovery.state = session->custom_active ? &session->frame_state : NULL;
+
+    if (device_recover_step(transport, &daemon->recovery) > 0)
+    {
+        loop_timer_set(fd, daemon->recovery.delay_us * 1000ULL, 0);
+        return;
+    }
+
+    daemon->recovering = false;
+}
+
+static void close_client(loop_t* loop, client_t* client)
+{
+    loop_remove(loop, client->fd);
+    close(client->fd);
+    client->fd = -1;
+}
+
+/**
+ * @brief Reads the available data of the client and applies its complete commands.
+ */
+static void on_client(loop_t* loop, int fd, uint32_t events, void* user)
+{
+    client_t* client = user;
+
+    while (1)
+    {
+        ssize_t n = recv(fd, client->buf + client->filled, sizeof(client->buf) - client->filled - 1, 0);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+
+        if (n <= 0)
+        {
+            close_client(loop, client);
+            return;
+        }
+
+        client->filled += n;
+        client->buf[client->filled] = '\0';
+
+        char* start = client->buf;
+        char* nl;
+        while ((nl = strchr(start, '\n')) != NULL)
+        {
+            *nl = '\0';
+
+            bool sent = handle_command(fd, start, &client->daemon->session);
+            watch_device(client->daemon);
+
+            if (!sent)
+            {
+                log_error("Client does not read its replies - Closing connection.");
+                close_client(loop, client);
+                return;
+            }
+
+            start = nl + 1;
+        }
+
+        client->filled -= start - client->buf;
+        memmove(client->buf, start, client->filled);
+
+        if (client->filled == sizeof(client->buf) - 1)
+        {
+            log_error("Command too long - Closing connection.");
+            close_client(loop, client);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Accepts the pending connections.
+ */
+static void on_accept(loop_t* loop, int fd, uint32_t events, void* user)
+{
+    daemon_t* daemon = user;
+
+    int conn;
+    while ((conn = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        client_t* client = NULL;
+        for (int i = 0; i < DAEMON_MAX_CLIENTS && client == NULL; i++)
+        {
+            if (daemon->clients[i].fd < 0)
+            {
+                client = &daemon->clients[i];
+            }
+        }
+
+        if (client == NULL || !loop_add(loop, conn, EPOLLIN, on_client, client))
+        {
+            log_error("Too many clients - Closing connection.");
+            close(conn);
+            continue;
+        }
+
+        client->fd = conn;
+        client->filled = 0;
+        client->daemon = daemon;
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        log_error("Error accepting connection - %s", strerror(errno));
+    }
+}
+
+void daemon_run(args_t* args)
+{
+    struct sockaddr_un addr;
+
+    if (!socket_address(args, &addr))
+    {
+        log_error("%s - Abort.\n", args->socket_path == NULL ? "XDG_RUNTIME_DIR is not set, use --socket" : "Socket path too long");
+        exit(EXIT_FAILURE);
+    }
+
+    loop_t loop;
+    if (!loop_init(&loop))
+    {
+        log_error("Error creating event loop - %s - Abort.\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    // A lost or stalled device is recovered by on_recover, so commands never wait for it.
+    transport.defer_recovery = true;
+    transport.timeout_ms = DAEMON_TRANSFER_TIMEOUT_MS;
+
+    // Completions of the libusb transfers are handled by the loop as well, see loop_attach_usb.
+    if (args->transport == TRANSPORT_LIBUSB)
+    {
+        loop_attach_usb(&loop, NULL);
+    }
+
+    int fd = socket_listen(&addr);
+
+    daemon_t daemon;
+    command_session_init(&daemon.session, &transport);
+
+    for (int i = 0; i < DAEMON_MAX_CLIENTS; i++)
+    {
+        daemon.clients[i].fd = -1;
+    }
+
+    daemon.recovering = false;
+    daemon.recover_timer = loop_timer(&loop, on_recover, &daemon);
+
+    if (daemon.recover_timer < 0)
+    {
+        log_error("Error creating timer - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    loop_add(&loop, fd, EPOLLIN, on_accept, &daemon);
+
+    log_info("Listening on %s", addr.sun_path);
+
+    loop_run(&loop);
+
+    log_info("Shutting down.");
+
+    for (int i = 0; i < DAEMON_MAX_CLIENTS; i++)
+    {
+        if (daemon.clients[i].fd >= 0)
+        {
+            close_client(&loop, &daemon.clients[i]);
+        }
+    }
+
+    loop_free(&loop);
+
+    close(fd);
+    unlink(addr.sun_path);
+
+    device_disconnect(&transport);
+}
+
+DAEMON_RESULT daemon_send(args_t* args, const lighting_t* lighting)
+{
+    struct sockaddr_un addr;
+
+    if (!socket_address(args, &addr))
+    {
+        return DAEMON_NOT_RUNNING;
+    }
+
+    int fd = socket_connect(&addr);
+
+    if (fd < 0)
+    {
+        return DAEMON_NOT_RUNNING;
+    }
+
+    // Only a daemon of the same user is trusted with the lighting and its reply.
+    struct ucred peer;
+    socklen_t peer_len = sizeof(peer);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_len) < 0 || (peer.uid != getuid() && peer.uid != 0))
+    {
+        log_error("Socket %s is not owned by the current user - Ignoring it.", addr.sun_path);
+        close(fd);
+        return DAEMON_NOT_RUNNING;
+    }
+
+    char line[DAEMON_LINE_LEN];
+    int len = lighting_format(lighting, line, sizeof(line) - 1);
+
+    if (len < 0 || len >= sizeof(line) - 1)
+    {
+        close(fd);
+        return DAEMON_FAILED;
+    }
+
+    line[len] = '\n';
+
+    if (send(fd, line, len + 1, MSG_NOSIGNAL) != len + 1)
+    {
+        log_error("Error sending command to daemon - %s", strerror(errno));
+        close(fd);
+        return DAEMON_FAILED;
+    }
+
+    char reply[DAEMON_LINE_LEN] = { 0 };
+    size_t filled = 0;
+
+    while (filled < sizeof(reply) - 1 && strchr(reply, '\n') == NULL)
+    {
+        ssize_t n = recv(fd, reply + filled, sizeof(reply) - filled - 1, 0);
+
+        if (n <= 0)
+        {
+            break;
+        }
+
+        filled += n;
+    }
+
+    close(fd);
+
+    if (strncmp(reply, "OK", 2) != 0)
+    {
+        reply[strcspn(reply, "\n")] = '\0';
+        log_error("Daemon could not apply lighting - %s", filled > 0 ? reply : "no reply");
+        return DAEMON_FAILED;
+    }
+
+    if (args->verbose)
+    {
+        log_info("Applied by daemon on %s: %.*s", addr.sun_path, len, line);
+    }
+
+    return DAEMON_APPLIED;
+}
@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "../args/args.h"
+
+#define DAEMON_SOCKET_NAME "cherrymxboard30s-rgb.sock"
+
+/**
+ * @brief Result of forwarding a lighting command to the daemon.
+ */
+typedef enum
+{
+    DAEMON_NOT_RUNNING = 0,
+    DAEMON_APPLIED = 1,
+    DAEMON_FAILED = 2,
+
+} DAEMON_RESULT;
+
+/**
+ * @brief Runs the lighting daemon. The device is opened once and lighting commands are read from a
+ * Unix socket until the daemon receives SIGINT or SIGTERM.
+ *
+ * @param args Application arguments.
+ */
+void daemon_run(args_t* args);
+
+/**
+ * @brief Sends the given lighting to a running daemon.
+ *
+ * @param args Application arguments.
+ * @param lighting Holds information about lighting.
+ * @return DAEMON_RESULT DAEMON_NOT_RUNNING if no daemon is listening on the socket.
+ */
+DAEMON_RESULT daemon_send(args_t* args, const lighting_t* lighting);
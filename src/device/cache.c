@@ -0,0 +1,308 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "dirent.h"
+#include "sys/stat.h"
+
+#include "cache.h"
+
+#define CACHE_DIR_NAME "cherrymxboard30s-rgb"
+#define CACHE_LINE_LEN 512
+
+/**
+ * @brief Determines the cache directory, $XDG_CACHE_HOME or ~/.cache.
+ *
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ * @return true The directory could be determined.
+ */
+static bool cache_dir(char* into, size_t len)
+{
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    int written;
+
+    if (xdg != NULL && xdg[0] != '\0')
+    {
+        written = snprintf(into, len, "%s/" CACHE_DIR_NAME, xdg);
+    }
+    else
+    {
+        const char* home = getenv("HOME");
+
+        if (home == NULL || home[0] == '\0')
+        {
+            return false;
+        }
+
+        written = snprintf(into, len, "%s/.cache/" CACHE_DIR_NAME, home);
+    }
+
+    return written > 0 && (size_t)written < len;
+}
+
+/**
+ * @brief Reads the id of the current boot, so the cache does not survive a reboot.
+ *
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ */
+static void boot_id(char* into, size_t len)
+{
+    into[0] = '\0';
+
+    FILE* file = fopen("/proc/sys/kernel/random/boot_id", "r");
+
+    if (file == NULL)
+    {
+        return;
+    }
+
+    if (fgets(into, len, file) != NULL)
+    {
+        into[strcspn(into, "\n")] = '\0';
+    }
+
+    fclose(file);
+}
+
+bool cache_entry_init(cache_entry_t* entry, struct libusb_device* dev)
+{
+    if (entry == NULL || dev == NULL)
+    {
+        return false;
+    }
+
+    char dir[PATH_MAX];
+
+    if (!cache_dir(dir, sizeof(dir)))
+    {
+        return false;
+    }
+
+    uint8_t ports[8];
+    int depth = libusb_get_port_numbers(dev, ports, sizeof(ports));
+
+    // Named after bus and port path, i.e. 1-2.4, like the sysfs name of the device.
+    char name[64];
+    int pos = snprintf(name, sizeof(name), "%u-", libusb_get_bus_number(dev));
+
+    for (int i = 0; i < depth && pos < (int)sizeof(name); i++)
+    {
+        pos += snprintf(name + pos, sizeof(name) - pos, i == 0 ? "%u" : ".%u", ports[i]);
+    }
+
+    if (depth <= 0)
+    {
+        snprintf(name + pos, sizeof(name) - pos, "0");
+    }
+
+    if (snprintf(entry->path, sizeof(entry->path), "%s/%s", dir, name) >= (int)sizeof(entry->path))
+    {
+        return false;
+    }
+
+    struct libusb_device_descriptor dev_dsc = { 0 };
+    libusb_get_device_descriptor(dev, &dev_dsc);
+
+    char boot[64];
+    boot_id(boot, sizeof(boot));
+
+    snprintf(entry->key, sizeof(entry->key), "%s %u %04x:%04x", boot, libusb_get_device_address(dev), dev_dsc.idVendor, dev_dsc.idProduct);
+
+    return true;
+}
+
+/**
+ * @brief Reads the stored lighting command of the entry.
+ *
+ * @param entry The entry of the device.
+ * @param line Receives the command.
+ * @param len Size of line.
+ * @return true A command is stored for the same device and boot.
+ */
+static bool read_line(const cache_entry_t* entry, char* line, size_t len)
+{
+    FILE* file = fopen(entry->path, "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    char key[CACHE_LINE_LEN];
+
+    bool read = fgets(key, sizeof(key), file) != NULL && fgets(line, len, file) != NULL;
+    fclose(file);
+
+    if (!read)
+    {
+        return false;
+    }
+
+    key[strcspn(key, "\n")] = '\0';
+    line[strcspn(line, "\n")] = '\0';
+
+    return strcmp(key, entry->key) == 0;
+}
+
+void cache_entry_salt(cache_entry_t* entry, uint32_t salt)
+{
+    size_t len = strlen(entry->key);
+    snprintf(entry->key + len, sizeof(entry->key) - len, " %08x", salt);
+}
+
+bool cache_matches(const cache_entry_t* entry, const lighting_t* lighting)
+{
+    if (entry == NULL || lighting == NULL)
+    {
+        return false;
+    }
+
+    char line[CACHE_LINE_LEN];
+
+    if (!read_line(entry, line, sizeof(line)))
+    {
+        return false;
+    }
+
+    char expected[CACHE_LINE_LEN];
+    lighting_format(lighting, expected, sizeof(expected));
+
+    return strcmp(line, expected) == 0;
+}
+
+bool cache_load(const cache_entry_t* entry, lighting_t* lighting)
+{
+    if (entry == NULL || lighting == NULL)
+    {
+        return false;
+    }
+
+    char line[CACHE_LINE_LEN];
+
+    if (!read_line(entry, line, sizeof(line)))
+    {
+        return false;
+    }
+
+    lighting_init(lighting);
+    return lighting_parse(line, lighting);
+}
+
+void cache_store(const cache_entry_t* entry, const lighting_t* lighting)
+{
+    if (entry == NULL || lighting == NULL)
+    {
+        return;
+    }
+
+    if (lighting->random_colors)
+    {
+        cache_clear(entry);
+        return;
+    }
+
+    char dir[PATH_MAX];
+
+    if (!cache_dir(dir, sizeof(dir)))
+    {
+        return;
+    }
+
+    // Parent of the cache directory might not exist yet either.
+    char* slash = strrchr(dir, '/');
+    if (slash != NULL)
+    {
+        *slash = '\0';
+        mkdir(dir, 0700);
+        *slash = '/';
+    }
+
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+    {
+        return;
+    }
+
+    char line[CACHE_LINE_LEN];
+    lighting_format(lighting, line, sizeof(line));
+
+    char tmp[PATH_MAX + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", entry->path);
+
+    FILE* file = fopen(tmp, "w");
+
+    if (file == NULL)
+    {
+        return;
+    }
+
+    fprintf(file, "%s\n%s\n", entry->key, line);
+
+    if (fclose(file) != 0 || rename(tmp, entry->path) != 0)
+    {
+        remove(tmp);
+    }
+}
+
+void cache_clear(const cache_entry_t* entry)
+{
+    if (entry != NULL)
+    {
+        remove(entry->path);
+    }
+}
+
+void cache_clear_all()
+{
+    char dir[PATH_MAX];
+
+    if (!cache_dir(dir, sizeof(dir)))
+    {
+        return;
+    }
+
+    DIR* d = opendir(dir);
+
+    if (d == NULL)
+    {
+        return;
+    }
+
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (ent->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char path[PATH_MAX + 256];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        remove(path);
+    }
+
+    closedir(d);
+}
@@ -0,0 +1,110 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdbool.h"
+#include "limits.h"
+
+#include "libusb-1.0/libusb.h"
+
+#include "lighting.h"
+
+/**
+ * @brief Cached lighting state of one device.
+ *
+ * The state is stored per USB port. It is only valid for the same device address and boot, so replugging the device
+ * or rebooting invalidates it. The device is not asked for its state, so changes made on the keyboard itself or a
+ * power loss that keeps the address are not noticed.
+ */
+typedef struct
+{
+    /**
+     * @brief Path of the cache file.
+     */
+    char path[PATH_MAX];
+
+    /**
+     * @brief Identifies the device and boot the state belongs to.
+     */
+    char key[128];
+
+} cache_entry_t;
+
+/**
+ * @brief Creates the cache entry of the given device. Does not open the device.
+ *
+ * @param entry Receives the entry.
+ * @param dev The device.
+ * @return true The entry was created.
+ * @return false No cache directory is available.
+ */
+bool cache_entry_init(cache_entry_t* entry, struct libusb_device* dev);
+
+/**
+ * @brief Adds a value the cached state depends on to the key of the entry, i.e. the color correction.
+ *
+ * @param entry The entry.
+ * @param salt The value.
+ */
+void cache_entry_salt(cache_entry_t* entry, uint32_t salt);
+
+/**
+ * @brief Checks if the device is known to show the given lighting.
+ *
+ * @param entry The entry of the device.
+ * @param lighting The requested lighting.
+ * @return true The device shows the lighting.
+ * @return false The state of the device is unknown or differs.
+ */
+bool cache_matches(const cache_entry_t* entry, const lighting_t* lighting);
+
+/**
+ * @brief Reads the lighting the device is known to show.
+ *
+ * @param entry The entry of the device.
+ * @param lighting Receives the lighting.
+ * @return true The lighting is known.
+ * @return false The state of the device is unknown.
+ */
+bool cache_load(const cache_entry_t* entry, lighting_t* lighting);
+
+/**
+ * @brief Stores the lighting the device was set to. A lighting with random colors differs on every application, it
+ * clears the entry instead.
+ *
+ * @param entry The entry of the device.
+ * @param lighting The applied lighting.
+ */
+void cache_store(const cache_entry_t* entry, const lighting_t* lighting);
+
+/**
+ * @brief Forgets the state of the device, i.e. after a failed transfer.
+ *
+ * @param entry The entry of the device.
+ */
+void cache_clear(const cache_entry_t* entry);
+
+/**
+ * @brief Forgets the state of all devices. Called by everything that changes the lighting without updating the cache.
+ */
+void cache_clear_all();
@@ -25,9 +25,17 @@ SOFTWARE. */
 #include "assert.h"
 #include "string.h"
 #include "ctype.h"
+#include "unistd.h"
+#include "time.h"
+#include "pthread.h"
 
 #include "device.h"
+#include "protocol.h"
+#include "pacing.h"
 #include "../log/log.h"
+#include "../stats/stats.h"
+#include "cache.h"
+#include "../color/correction.h"
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 #define MSG_LEN 64
@@ -38,68 +46,35 @@ SOFTWARE. */
  */
 typedef int (*iffunc)(struct libusb_device_handle*, int);
 
-/**
- * @brief Get the device pointer from the current handle.
- *
- * @param handle USB device handle.
- *
- * @return libusb_device* The device pointer.
- */
-static struct libusb_device* get_device(struct libusb_device_handle* handle)
-{
-    assert(handle != NULL);
-
-    libusb_device* dev;
-    dev = libusb_get_device(handle);
-
-    if (dev == NULL)
-    {
-        log_error("%s - Abort.\n", "Error getting device from handle.");
-        exit(EXIT_FAILURE);
-    }
-
-    return dev;
-}
-
-/**
- * @brief Get the device descriptor pointer from the given device.
- *
- * @param into Pointer to a libusb_device_descriptor struct.
- * @param dev Device for descriptor.
- */
-static void get_device_descriptor(struct libusb_device_descriptor* into, struct libusb_device* dev)
-{
-    int ret = libusb_get_device_descriptor(dev, into);
-
-    if (ret < LIBUSB_SUCCESS)
-    {
-        log_error("Error getting device descriptor - %s - Abort.\n", libusb_error_name(ret));
-        exit(EXIT_FAILURE);
-    }
-}
-
 /**
  * @brief Applies the given function to all interfaces of a device.
  *
  * @param handle Device handle.
  * @param func The function that shall be applied.
+ * @return int LIBUSB_SUCCESS or the first error.
  */
-static void perform_on_all_interfaces(struct libusb_device_handle* handle, iffunc func)
+static int try_on_all_interfaces(struct libusb_device_handle* handle, iffunc func)
 {
-    struct libusb_device* dev = get_device(handle);
+    struct libusb_device* dev = libusb_get_device(handle);
     struct libusb_device_descriptor dev_dsc;
 
-    get_device_descriptor(&dev_dsc, dev);
+    int ret = libusb_get_device_descriptor(dev, &dev_dsc);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        log_error("Error getting device descriptor - %s\n", libusb_error_name(ret));
+        return ret;
+    }
 
     struct libusb_config_descriptor* cfg_dsc;
     for (int i = 0; i < dev_dsc.bNumConfigurations; i++)
     {
-        int ret = libusb_get_config_descriptor(dev, i, &cfg_dsc);
+        ret = libusb_get_config_descriptor(dev, i, &cfg_dsc);
 
         if (ret < LIBUSB_SUCCESS)
         {
-            log_error("Error getting config descriptor - %s - Abort.\n", libusb_error_name(ret));
-            exit(EXIT_FAILURE);
+            log_error("Error getting config descriptor - %s\n", libusb_error_name(ret));
+            return ret;
         }
 
         for (int j = 0; j < cfg_dsc->bNumInterfaces; j++)
@@ -110,20 +85,31 @@ static void perform_on_all_interfaces(struct libusb_device_handle* handle, iffun
 
             if (ret < LIBUSB_SUCCESS)
             {
-                log_error("Error releasing interface %i - %s - Abort.\n", intf_num, libusb_error_name(ret));
-                exit(EXIT_FAILURE);
+                log_error("Error %s interface %i - %s\n", func == libusb_claim_interface ? "claiming" : "releasing", intf_num, libusb_error_name(ret));
+                libusb_free_config_descriptor(cfg_dsc);
+                return ret;
             }
         }
+
+        libusb_free_config_descriptor(cfg_dsc);
     }
+
+    return LIBUSB_SUCCESS;
 }
 
 /**
  * @brief Get the device index from user input.
  *
- * @return int Chosen device index.
+ * @return int Chosen device index or -1 if no index can be read.
  */
 static int get_device_index()
 {
+    if (!isatty(STDIN_FILENO))
+    {
+        log_error("Cannot choose a device without a terminal. Use --all to apply the lighting to all devices.\n");
+        return -1;
+    }
+
     int chosen = 0;
     while (1)
     {
@@ -137,8 +123,8 @@ static int get_device_index()
 
         if (in == NULL)
         {
-            log_error("Error choosing USB device - Abort.\n");
-            exit(EXIT_FAILURE);
+            log_error("Error choosing USB device.\n");
+            return -1;
         }
 
         if (!isdigit(buf[0]))
@@ -166,7 +152,9 @@ static int get_device_index()
 
 void device_setup(args_t* args)
 {
+    uint64_t start = stats_now();
     int init = libusb_init(NULL);
+    stats_phase_end(STATS_PHASE_SETUP, start);
 
     if (init < LIBUSB_SUCCESS)
     {
@@ -186,15 +174,28 @@ void device_setup(args_t* args)
     }
 }
 
-void device_find(args_t* args, struct libusb_device_handle** handleptr)
+/**
+ * @brief Searches for the device. Asks which one to use if more than one device is found.
+ *
+ * @param args Application arguments.
+ * @param list Receives the device list, which must be freed with libusb_free_device_list after opening the device.
+ * @param devptr Receives the chosen device.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_NOT_FOUND if no device matches or another libusb error code. The device
+ * list is only returned on success.
+ */
+static int select_device(args_t* args, libusb_device*** list, struct libusb_device** devptr)
 {
+    uint64_t start = stats_now();
+
     libusb_device** devices;
     int found = libusb_get_device_list(NULL, &devices);
 
+    stats_phase_end(STATS_PHASE_ENUMERATE, start);
+
     if (found < LIBUSB_SUCCESS)
     {
-        log_error("Error finding USB devices - %s - Abort.\n", libusb_error_name(found));
-        exit(EXIT_FAILURE);
+        log_error("Error finding USB devices - %s\n", libusb_error_name(found));
+        return found;
     }
 
     uint16_t search_vendor = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
@@ -207,6 +208,8 @@ void device_find(args_t* args, struct libusb_device_handle** handleptr)
     int chosen = 0;
 
     // Identify all matching devices that are connected.
+    start = stats_now();
+
     int ret = 0;
     for (int i = 0; i < found; i++)
     {
@@ -218,8 +221,9 @@ void device_find(args_t* args, struct libusb_device_handle** handleptr)
 
         if (ret < LIBUSB_SUCCESS)
         {
-            log_error("Error retrieving device descriptor - %s - Abort.\n", libusb_error_name(ret));
-            exit(EXIT_FAILURE);
+            log_error("Error retrieving device descriptor - %s\n", libusb_error_name(ret));
+            libusb_free_device_list(devices, 1);
+            return ret;
         }
 
         if (dev_dsc.idVendor == search_vendor && dev_dsc.idProduct == search_product)
@@ -228,6 +232,8 @@ void device_find(args_t* args, struct libusb_device_handle** handleptr)
         }
     }
 
+    stats_phase_end(STATS_PHASE_DESCRIPTORS, start);
+
     // More than one device
     if (ind_i > 1)
     {
@@ -247,8 +253,9 @@ void device_find(args_t* args, struct libusb_device_handle** handleptr)
 
             if (ret < LIBUSB_SUCCESS)
             {
-                log_error("Error retrieving device descriptor - %s - Abort.\n", libusb_error_name(ret));
-                exit(EXIT_FAILURE);
+                log_error("Error retrieving device descriptor - %s\n", libusb_error_name(ret));
+                libusb_free_device_list(devices, 1);
+                return ret;
             }
 
             uint8_t busnum = libusb_get_bus_number(dev);
@@ -267,409 +274,999 @@ void device_find(args_t* args, struct libusb_device_handle** handleptr)
 
     if (chosen > found - 1)
     {
-        log_error("The given index was invalid. Index must not be bigger than %i - Abort.\n", found - 1);
-        exit(EXIT_FAILURE);
+        log_error("The given index was invalid. Index must not be bigger than %i\n", found - 1);
+        libusb_free_device_list(devices, 1);
+        return LIBUSB_ERROR_INVALID_PARAM;
     }
 
     if (chosen == -1)
     {
-        log_info("No appropriate device found.\n");
-        exit(EXIT_SUCCESS);
+        libusb_free_device_list(devices, 1);
+        return ind_i > 1 ? LIBUSB_ERROR_INVALID_PARAM : LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    *list = devices;
+    *devptr = devices[chosen];
+    return LIBUSB_SUCCESS;
+}
+
+int device_find(args_t* args, struct libusb_device_handle** handleptr)
+{
+    libusb_device** devices;
+    struct libusb_device* dev;
+    int ret = select_device(args, &devices, &dev);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        return ret;
     }
 
-    ret = libusb_open(devices[chosen], handleptr);
+    ret = device_open(dev, handleptr);
 
     if (ret < LIBUSB_SUCCESS)
     {
-        log_error("Error opening device - %s - Abort.\n", libusb_error_name(ret));
-        exit(EXIT_FAILURE);
+        log_error("Error opening device - %s\n", libusb_error_name(ret));
+    }
+
+    libusb_free_device_list(devices, 1);
+
+    return ret;
+}
+
+int device_find_all(args_t* args, struct libusb_device_handle** handles, int max)
+{
+    uint64_t start = stats_now();
+
+    libusb_device** devices;
+    int found = libusb_get_device_list(NULL, &devices);
+
+    stats_phase_end(STATS_PHASE_ENUMERATE, start);
+
+    if (found < LIBUSB_SUCCESS)
+    {
+        log_error("Error finding USB devices - %s\n", libusb_error_name(found));
+        return found;
+    }
+
+    uint16_t search_vendor = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
+    uint16_t search_product = args->product_id != -1 ? args->product_id : DEFAULT_PRODUCT_ID;
+
+    int ret = 0;
+    int opened = 0;
+    for (int i = 0; i < found && opened < max; i++)
+    {
+        struct libusb_device_descriptor dev_dsc = { 0 };
+
+        start = stats_now();
+        ret = libusb_get_device_descriptor(devices[i], &dev_dsc);
+        stats_phase_end(STATS_PHASE_DESCRIPTORS, start);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            continue;
+        }
+
+        if (dev_dsc.idVendor != search_vendor || dev_dsc.idProduct != search_product)
+        {
+            continue;
+        }
+
+        ret = device_open(devices[i], &handles[opened]);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            log_error("Error opening device - Bus: %i, Device: %i - %s", libusb_get_bus_number(devices[i]), libusb_get_device_address(devices[i]), libusb_error_name(ret));
+            continue;
+        }
+
+        opened++;
     }
 
     libusb_free_device_list(devices, 1);
 
-    if (*handleptr == NULL)
+    return opened;
+}
+
+int device_open(struct libusb_device* dev, struct libusb_device_handle** handleptr)
+{
+    assert(dev != NULL);
+    assert(handleptr != NULL);
+
+    uint64_t start = stats_now();
+    int ret = libusb_open(dev, handleptr);
+    stats_phase_end(STATS_PHASE_OPEN, start);
+
+    if (ret < LIBUSB_SUCCESS)
     {
-        log_info("%s\n", "No matching device found");
-        exit(EXIT_SUCCESS);
+        return ret;
     }
 
     ret = libusb_set_auto_detach_kernel_driver(*handleptr, 1);
 
+    if (ret == LIBUSB_SUCCESS)
+    {
+        start = stats_now();
+        ret = try_on_all_interfaces(*handleptr, libusb_claim_interface);
+        stats_phase_end(STATS_PHASE_CLAIM, start);
+    }
+
     if (ret < LIBUSB_SUCCESS)
     {
-        log_error("%s - Abort.\n", libusb_error_name(ret));
-        exit(EXIT_FAILURE);
+        libusb_close(*handleptr);
+        *handleptr = NULL;
+    }
+
+    return ret;
+}
+
+void device_close(struct libusb_device_handle* handle)
+{
+    if (handle == NULL)
+    {
+        return;
     }
 
-    perform_on_all_interfaces(*handleptr, libusb_claim_interface);
+    try_on_all_interfaces(handle, libusb_release_interface);
+    libusb_close(handle);
+}
+
+/**
+ * @brief Looks up the protocol model of the device.
+ *
+ * @param transport The opened device.
+ * @return const protocol_model_t* The matching model or the default model for unknown ids.
+ */
+static const protocol_model_t* get_model(transport_t* transport)
+{
+    const protocol_model_t* model = protocol_find_model(transport->vendor_id, transport->product_id);
+
+    return model != NULL ? model : protocol_default_model();
 }
 
-void device_static_light(lighting_t lighting, struct libusb_device_handle* handle)
+/**
+ * @brief Uploads per key colors, see device_custom_frame.
+ */
+static int custom_frame(const frame_t* frame, frame_state_t* state, transport_t* transport)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x69, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x03,
-        lighting.brightness, 0x02, 0x00, 0x00, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    assert(frame != NULL);
+
+    frame_t corrected;
+    if (transport->correction != NULL)
+    {
+        correction_apply_frame(transport->correction, frame, &corrected);
+        frame = &corrected;
+    }
+
+    uint8_t changed = frame_changed_chunks(frame, state);
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    if (state != NULL)
+    {
+        state->pending = 0;
+    }
 
-    if (written < LIBUSB_SUCCESS)
+    if (changed == 0)
     {
-        log_error("Error setting STATIC lighting - %s\n", libusb_error_name(written));
+        return 0;
     }
+
+    uint8_t reports[FRAME_CHUNKS][MSG_LEN];
+    uint8_t sent = 0;
+    int count = 0;
+
+    // With pacing only a part of the changed reports is sent, starting where the last partial upload stopped.
+    int limit = state != NULL ? pacing_reports_per_frame(transport->pacing) : FRAME_CHUNKS;
+    int first = state != NULL && limit < FRAME_CHUNKS ? state->next_chunk : 0;
+
+    for (int n = 0; n < FRAME_CHUNKS && count < limit; n++)
+    {
+        int i = (first + n) % FRAME_CHUNKS;
+
+        if (changed & (1 << i))
+        {
+            protocol_encode_chunk(frame, i, reports[count++]);
+            sent |= 1 << i;
+
+            if (state != NULL)
+            {
+                state->next_chunk = (i + 1) % FRAME_CHUNKS;
+            }
+        }
+    }
+
+    int ret = transport_send_many(transport, reports[0], count);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        log_error("Error setting CUSTOM key colors - %s\n", libusb_error_name(ret));
+
+        if (state != NULL)
+        {
+            state->synced = false;
+        }
+
+        return ret;
+    }
+
+    if (state != NULL)
+    {
+        for (int i = 0; i < FRAME_CHUNKS; i++)
+        {
+            if (sent & (1 << i))
+            {
+                memcpy(&state->shown.keys[i * FRAME_CHUNK_KEYS], &frame->keys[i * FRAME_CHUNK_KEYS], sizeof(rgb_t) * FRAME_CHUNK_KEYS);
+            }
+        }
+
+        state->unknown = state->synced ? state->unknown & ~sent : ((1 << FRAME_CHUNKS) - 1) & ~sent;
+        state->pending = changed & ~sent;
+        state->synced = true;
+    }
+
+    return MSG_LEN * count;
 }
 
-void device_wave_light(lighting_t lighting, struct libusb_device_handle* handle)
+static void print_args(args_t* args)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x65 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x00,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    assert(args != NULL);
+
+    log_info("Lighting mode: %s", lighting_mode_str(args->lighting));
+    log_info("Red: %d", args->red);
+    log_info("Green: %d", args->green);
+    log_info("Blue: %d", args->blue);
+    log_info("Speed: %d", args->speed);
+    log_info("Brightness: %d", args->brightness);
+    log_info("Random colors: %d", args->random_colors);
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    if (args->vendor_id == -1)
+    {
+        log_info("Vendor Id: Default");
+    }
+    else
+    {
+        log_info("Vendor Id: %d", args->vendor_id);
+    }
 
-    if (written < LIBUSB_SUCCESS)
+    if (args->product_id == -1)
     {
-        log_error("Error setting WAVE lighting - %s\n", libusb_error_name(written));
+        log_info("Product Id: Default");
+    }
+    else
+    {
+        log_info("Product Id: %d", args->product_id);
     }
 }
 
-void device_spectrum_light(lighting_t lighting, struct libusb_device_handle* handle)
+/**
+ * @brief Encodes the given lighting and sends it, see device_apply_lighting.
+ */
+static int apply_lighting(lighting_t lighting, transport_t* transport)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x66 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x01,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    assert(transport != NULL);
+
+    uint8_t data[MSG_LEN];
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    // The key colors of CUSTOM lighting are corrected by device_custom_frame.
+    rgb_t color = { lighting.red, lighting.green, lighting.blue };
+    lighting_t sent = lighting;
 
-    if (written < LIBUSB_SUCCESS)
+    if (transport->correction != NULL)
     {
-        log_error("Error setting SPECTRUM lighting - %s\n", libusb_error_name(written));
+        rgb_t corrected = correction_apply(transport->correction, color);
+
+        sent.red = corrected.red;
+        sent.green = corrected.green;
+        sent.blue = corrected.blue;
+    }
+
+    if (!protocol_encode(get_model(transport), &sent, data))
+    {
+        log_error("%s lighting is not supported by the device\n", lighting_mode_str(lighting.mode));
+        return LIBUSB_ERROR_NOT_SUPPORTED;
     }
+
+    int ret = transport_send(transport, data);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        log_error("Error setting %s lighting - %s\n", lighting_mode_str(lighting.mode), libusb_error_name(ret));
+        return ret;
+    }
+
+    if (lighting.mode == CUSTOM)
+    {
+        // Custom mode shows the uploaded key colors, start with all keys set to the lighting color.
+        frame_t frame;
+        frame_fill(&frame, color);
+
+        int uploaded = custom_frame(&frame, NULL, transport);
+        return uploaded < LIBUSB_SUCCESS ? uploaded : MSG_LEN + uploaded;
+    }
+
+    return MSG_LEN;
 }
 
-void device_breathing_light(lighting_t lighting, struct libusb_device_handle* handle)
+/**
+ * @brief Returns whether the device has to be opened again after the error, i.e. because it was replugged, switched by
+ * a KVM or reset. With a transfer timeout a stalled device is treated as lost as well.
+ *
+ * @param transport The transport the error occurred on.
+ * @param error A libusb error code.
+ * @return true The device is lost.
+ */
+static bool is_lost(const transport_t* transport, int error)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x67 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x02,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    return error == LIBUSB_ERROR_NO_DEVICE || error == LIBUSB_ERROR_PIPE || error == LIBUSB_ERROR_BUSY || error == LIBUSB_ERROR_IO
+        || (error == LIBUSB_ERROR_TIMEOUT && transport->timeout_ms > 0);
+}
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+/**
+ * @brief Opens the device with the ids of the transport at the port it was connected to.
+ *
+ * @param transport The lost libusb transport.
+ * @param handleptr Receives the USB device handle.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_NOT_FOUND if the device is not connected or another libusb error code.
+ */
+static int open_at_port(const transport_t* transport, struct libusb_device_handle** handleptr)
+{
+    libusb_device** devices;
+    int found = libusb_get_device_list(NULL, &devices);
 
-    if (written < LIBUSB_SUCCESS)
+    if (found < LIBUSB_SUCCESS)
     {
-        log_error("Error setting BREATHING lighting - %s\n", libusb_error_name(written));
+        return found;
     }
+
+    int ret = LIBUSB_ERROR_NOT_FOUND;
+    for (int i = 0; i < found; i++)
+    {
+        struct libusb_device_descriptor dev_dsc = { 0 };
+
+        if (libusb_get_device_descriptor(devices[i], &dev_dsc) < LIBUSB_SUCCESS
+            || dev_dsc.idVendor != transport->vendor_id || dev_dsc.idProduct != transport->product_id)
+        {
+            continue;
+        }
+
+        // With several boards connected only the one at the same port is the lost device.
+        uint8_t ports[sizeof(transport->ports)];
+        int depth = libusb_get_port_numbers(devices[i], ports, sizeof(ports));
+
+        if (libusb_get_bus_number(devices[i]) != transport->bus || depth != transport->port_count
+            || memcmp(ports, transport->ports, depth > 0 ? depth : 0) != 0)
+        {
+            continue;
+        }
+
+        ret = device_open(devices[i], handleptr);
+        break;
+    }
+
+    libusb_free_device_list(devices, 1);
+
+    return ret;
 }
 
-void device_rolling_light(lighting_t lighting, struct libusb_device_handle* handle)
+/**
+ * @brief Opens the lost device of the transport again. Everything but the device itself is kept.
+ *
+ * @param transport The transport.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+static int reopen(transport_t* transport)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x6f + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x0a,
-        lighting.brightness, lighting.speed, 0x00, 0x01, 0xff,
-        0xff, 0xff, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    transport_t opened;
+    int ret;
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    if (transport->type == TRANSPORT_LIBUSB)
+    {
+        struct libusb_device_handle* handle = NULL;
+        ret = open_at_port(transport, &handle);
 
-    if (written < LIBUSB_SUCCESS)
+        if (ret == LIBUSB_SUCCESS)
+        {
+            transport_libusb_init(&opened, handle);
+        }
+    }
+    else if (transport->type == TRANSPORT_HIDRAW)
+    {
+        ret = transport_hidraw_open(&opened, transport->vendor_id, transport->product_id, transport->index);
+    }
+    else
     {
-        log_error("Error setting ROLLING lighting - %s\n", libusb_error_name(written));
+        // The mock device is never closed, the transfers are just tried again.
+        return LIBUSB_SUCCESS;
     }
+
+    if (ret == LIBUSB_SUCCESS)
+    {
+        transport->ops = opened.ops;
+        transport->handle = opened.handle;
+        transport->queue = opened.queue;
+        transport->fd = opened.fd;
+    }
+
+    return ret;
 }
 
-void device_curve_light(lighting_t lighting, struct libusb_device_handle* handle)
+/**
+ * @brief Closes the lost device and marks the transport lost. The mock device is kept open.
+ *
+ * @param transport The transport.
+ */
+static void close_lost(transport_t* transport)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x71 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x0c,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    if (transport->type != TRANSPORT_MOCK)
+    {
+        transport->ops->close(transport);
+    }
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    transport->lost = true;
+}
 
-    if (written < LIBUSB_SUCCESS)
+/**
+ * @brief Marks the transport lost after the given error, unless it already is.
+ *
+ * @param transport The transport.
+ * @param error Error of the last transfer.
+ */
+static void lose(transport_t* transport, int error)
+{
+    if (!transport->lost)
     {
-        log_error("Error setting CURVE lighting - %s\n", libusb_error_name(written));
+        log_error("Lost the device - %s - Reconnecting", libusb_error_name(error));
+        close_lost(transport);
     }
 }
 
-void device_scan_light(lighting_t lighting, struct libusb_device_handle* handle)
+static double elapsed_ms(const struct timespec* since)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x71 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x0f,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    return (now.tv_sec - since->tv_sec) * 1e3 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+bool device_recover_start(transport_t* transport, int error, device_recovery_t* recovery)
+{
+    assert(transport != NULL);
+    assert(recovery != NULL);
 
-    if (written < LIBUSB_SUCCESS)
+    if (!is_lost(transport, error) && !transport->lost)
     {
-        log_error("Error setting SCAN lighting - %s\n", libusb_error_name(written));
+        return false;
     }
+
+    lose(transport, error);
+
+    recovery->attempt = 0;
+    recovery->delay_us = DEVICE_RECOVER_MIN_US;
+    recovery->frame = NULL;
+    recovery->state = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &recovery->start);
+
+    return true;
 }
 
-void device_custom_light(lighting_t lighting, struct libusb_device_handle* handle)
+int device_recover_step(transport_t* transport, device_recovery_t* recovery)
 {
-    /* TODO: */
+    assert(transport != NULL);
+    assert(recovery != NULL);
+
+    recovery->attempt++;
+
+    int ret = reopen(transport);
+
+    if (ret == LIBUSB_SUCCESS)
+    {
+        transport->lost = false;
+
+        // The device starts with its default lighting after it was replugged.
+        if (transport->has_lighting)
+        {
+            ret = apply_lighting(transport->lighting, transport);
+        }
+
+        if (ret >= LIBUSB_SUCCESS && recovery->frame != NULL)
+        {
+            ret = custom_frame(recovery->frame, recovery->state, transport);
+        }
+
+        if (ret >= LIBUSB_SUCCESS)
+        {
+            log_info("Recovered the device after %.1f ms and %i attempts", elapsed_ms(&recovery->start), recovery->attempt);
+            return LIBUSB_SUCCESS;
+        }
+
+        close_lost(transport);
+    }
+
+    if (recovery->attempt >= DEVICE_RECOVER_ATTEMPTS)
+    {
+        log_error("Could not recover the device within %.1f ms - %s", elapsed_ms(&recovery->start), libusb_error_name(ret));
+        return ret;
+    }
+
+    recovery->delay_us = recovery->delay_us * 2 < DEVICE_RECOVER_MAX_US ? recovery->delay_us * 2 : DEVICE_RECOVER_MAX_US;
+
+    return 1;
 }
 
-void device_radiation_light(lighting_t lighting, struct libusb_device_handle* handle)
+int device_recover(transport_t* transport, int error)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x77 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x12,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    device_recovery_t recovery;
+
+    if (!device_recover_start(transport, error, &recovery))
+    {
+        return error;
+    }
+
+    int ret;
+    do
+    {
+        usleep(recovery.delay_us);
+        ret = device_recover_step(transport, &recovery);
+    } while (ret > 0);
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    return ret;
+}
+
+int device_custom_frame(const frame_t* frame, frame_state_t* state, transport_t* transport)
+{
+    int ret = custom_frame(frame, state, transport);
 
-    if (written < LIBUSB_SUCCESS)
+    if (is_lost(transport, ret) && transport->defer_recovery)
+    {
+        lose(transport, ret);
+    }
+    // The lighting was applied again, so the state is unsynced and the whole frame is sent.
+    else if (is_lost(transport, ret) && device_recover(transport, ret) == LIBUSB_SUCCESS)
     {
-        log_error("Error setting RADIATION lighting - %s\n", libusb_error_name(written));
+        ret = custom_frame(frame, state, transport);
     }
+
+    return ret;
 }
 
-void device_ripples_light(lighting_t lighting, struct libusb_device_handle* handle)
+int device_apply_lighting(lighting_t lighting, transport_t* transport)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x78 + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x13,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
+    int ret = apply_lighting(lighting, transport);
 
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    // The requested lighting is pending until it was sent, device_recover applies it once the device is back.
+    if (ret >= LIBUSB_SUCCESS || is_lost(transport, ret))
+    {
+        transport->lighting = lighting;
+        transport->has_lighting = true;
+    }
 
-    if (written < LIBUSB_SUCCESS)
+    if (is_lost(transport, ret) && transport->defer_recovery)
     {
-        log_error("Error setting RIPPLES lighting - %s\n", libusb_error_name(written));
+        lose(transport, ret);
     }
+    else if (is_lost(transport, ret))
+    {
+        ret = device_recover(transport, ret);
+    }
+
+    return ret;
 }
 
-void device_single_key_light(lighting_t lighting, struct libusb_device_handle* handle)
+/**
+ * @brief Ends the program if the device could not be opened at start. Errors of an opened device are handled by
+ * device_recover instead.
+ *
+ * @param ret Result of select_device or device_open.
+ */
+static void exit_on_error(int ret)
 {
-    uint8_t data[MSG_LEN] = {
-        0x04, 0x7a + lighting.speed, 0x03, 0x06, 0x09,
-        0x00, 0x00, 0x55, 0x00, 0x15,
-        lighting.brightness, lighting.speed, 0x00, lighting.random_colors, lighting.red,
-        lighting.green, lighting.blue, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00 };
-
-    int written = libusb_control_transfer(handle, 0x21, 0x09, 0x0204, 0x0001, data, ARRAY_SIZE(data), 0);
+    if (ret == LIBUSB_ERROR_NOT_FOUND)
+    {
+        log_info("No appropriate device found.\n");
+        exit(EXIT_SUCCESS);
+    }
 
-    if (written < LIBUSB_SUCCESS)
+    if (ret < LIBUSB_SUCCESS)
     {
-        log_error("Error setting SINGLE KEY lighting - %s\n", libusb_error_name(written));
+        log_error("Abort.\n");
+        exit(EXIT_FAILURE);
     }
 }
 
-static void print_args(args_t* args)
+/**
+ * @brief Opens the device using the transport selected in args. If no device is found the program exits.
+ *
+ * @param args Application arguments.
+ * @param transport Receives the opened device.
+ * @param entry Receives the cache entry of the device if not NULL. Otherwise the whole cache is cleared.
+ * @return true entry is valid.
+ */
+static bool connect(args_t* args, transport_t* transport, cache_entry_t* entry)
 {
     assert(args != NULL);
+    assert(transport != NULL);
 
-    log_info("Lighting mode: %s", lighting_mode_str(args->lighting));
-    log_info("Red: %d", args->red);
-    log_info("Green: %d", args->green);
-    log_info("Blue: %d", args->blue);
-    log_info("Speed: %d", args->speed);
-    log_info("Brightness: %d", args->brightness);
-    log_info("Random colors: %d", args->random_colors);
+    bool cached = false;
 
-    if (args->vendor_id == -1)
+    // The lighting is changed without updating the cache.
+    if (args->transport != TRANSPORT_MOCK && (entry == NULL || args->transport != TRANSPORT_LIBUSB))
     {
-        log_info("Vendor Id: Default");
+        cache_clear_all();
     }
-    else
+
+    if (args->transport == TRANSPORT_HIDRAW)
     {
-        log_info("Vendor Id: %d", args->vendor_id);
+        uint16_t search_vendor = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
+        uint16_t search_product = args->product_id != -1 ? args->product_id : DEFAULT_PRODUCT_ID;
+
+        uint64_t start = stats_now();
+        int ret = transport_hidraw_open(transport, search_vendor, search_product, 0);
+        stats_phase_end(STATS_PHASE_OPEN, start);
+
+        if (ret == LIBUSB_ERROR_NOT_FOUND)
+        {
+            log_info("No appropriate hidraw device found.\n");
+            exit(EXIT_SUCCESS);
+        }
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            log_error("Error opening hidraw device - %s - Abort.\n", libusb_error_name(ret));
+            exit(EXIT_FAILURE);
+        }
     }
 
-    if (args->product_id == -1)
+    else if (args->transport == TRANSPORT_MOCK)
     {
-        log_info("Product Id: Default");
+        mock_config_t config = { args->mock_latency_us, args->mock_fail_every, args->mock_error };
+
+        uint64_t start = stats_now();
+        int ret = transport_mock_open(transport, &config);
+        stats_phase_end(STATS_PHASE_OPEN, start);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            log_error("Error creating mock device - Abort.\n");
+            exit(EXIT_FAILURE);
+        }
     }
     else
     {
-        log_info("Product Id: %d", args->product_id);
+        struct libusb_device_handle* handle = NULL;
+
+        device_setup(args);
+
+        libusb_device** devices;
+        struct libusb_device* dev;
+        exit_on_error(select_device(args, &devices, &dev));
+
+        if (entry != NULL)
+        {
+            cached = cache_entry_init(entry, dev);
+
+            if (cached && args->correction.enabled)
+            {
+                cache_entry_salt(entry, args->correction.id);
+            }
+        }
+
+        int ret = device_open(dev, &handle);
+        libusb_free_device_list(devices, 1);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            log_error("Error opening device - %s\n", libusb_error_name(ret));
+        }
+
+        exit_on_error(ret);
+
+        transport_libusb_init(transport, handle);
+    }
+
+    if (args->record_path != NULL && !transport_record(transport, args->record_path))
+    {
+        log_error("Error opening %s - Abort.\n", args->record_path);
+        exit(EXIT_FAILURE);
     }
+
+    transport->correction = args->correction.enabled ? &args->correction : NULL;
+
+    return cached;
 }
 
-void device_set_lighting(args_t* args)
+void device_connect(args_t* args, transport_t* transport)
 {
-    assert(args != NULL);
+    connect(args, transport, NULL);
+}
 
-    struct libusb_device_handle* handle = NULL;
+bool device_connect_cached(args_t* args, transport_t* transport, cache_entry_t* entry)
+{
+    assert(entry != NULL);
 
-    device_setup(args);
-    device_find(args, &handle);
+    return connect(args, transport, entry);
+}
 
+void device_disconnect(transport_t* transport)
+{
+    TRANSPORT_TYPE type = transport->type;
+
+    transport_close(transport);
+
+    if (type == TRANSPORT_LIBUSB)
+    {
+        uint64_t start = stats_now();
+        libusb_exit(NULL);
+        stats_phase_end(STATS_PHASE_CLEANUP, start);
+    }
+}
+
+/**
+ * @brief Work of one device when setting the lighting of all devices.
+ */
+typedef struct
+{
+    pthread_t thread;
+    transport_t transport;
     lighting_t lighting;
-    lighting_init(&lighting);
 
-    lighting.red = args->red;
-    lighting.green = args->green;
-    lighting.blue = args->blue;
-    lighting.mode = args->lighting;
-    lighting.speed = args->speed;
-    lighting.brightness = args->brightness;
-    lighting.random_colors = args->random_colors;
+    int result;
+    double ms;
+
+} worker_t;
+
+/**
+ * @brief Thread function applying the lighting to the device of one worker.
+ *
+ * @param arg The worker_t.
+ * @return void* Always NULL.
+ */
+static void* worker_run(void* arg)
+{
+    worker_t* worker = arg;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    worker->result = device_apply_lighting(worker->lighting, &worker->transport);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    worker->ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+    return NULL;
+}
+
+/**
+ * @brief Opens all matching devices with the transport selected in args.
+ *
+ * @param args Application arguments.
+ * @param workers Receive the opened devices.
+ * @return int Number of opened devices.
+ */
+static int connect_all(args_t* args, worker_t* workers)
+{
+    int count = 0;
+
+    if (args->transport == TRANSPORT_HIDRAW)
+    {
+        uint16_t search_vendor = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
+        uint16_t search_product = args->product_id != -1 ? args->product_id : DEFAULT_PRODUCT_ID;
+
+        while (count < DEVICE_MAX_BOARDS)
+        {
+            int ret = transport_hidraw_open(&workers[count].transport, search_vendor, search_product, count);
+
+            if (ret < LIBUSB_SUCCESS)
+            {
+                if (ret != LIBUSB_ERROR_NOT_FOUND)
+                {
+                    log_error("Error opening hidraw device %i - %s", count, libusb_error_name(ret));
+                }
+
+                break;
+            }
+
+            count++;
+        }
+
+        return count;
+    }
+
+    if (args->transport == TRANSPORT_MOCK)
+    {
+        device_connect(args, &workers[0].transport);
+        return 1;
+    }
+
+    struct libusb_device_handle* handles[DEVICE_MAX_BOARDS];
+
+    device_setup(args);
+    count = device_find_all(args, handles, DEVICE_MAX_BOARDS);
+
+    if (count < LIBUSB_SUCCESS)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        transport_libusb_init(&workers[i].transport, handles[i]);
+    }
+
+    return count;
+}
+
+void device_set_lighting_all(args_t* args)
+{
+    assert(args != NULL);
+
+    if (args->transport != TRANSPORT_MOCK)
+    {
+        cache_clear_all();
+    }
+
+    worker_t workers[DEVICE_MAX_BOARDS];
+    int count = connect_all(args, workers);
+
+    if (count == 0)
+    {
+        log_info("No appropriate device found.\n");
+
+        if (args->transport == TRANSPORT_LIBUSB)
+        {
+            libusb_exit(NULL);
+        }
+
+        return;
+    }
+
+    lighting_t lighting;
+    args_to_lighting(args, &lighting);
 
     print_args(args);
 
-    switch (lighting.mode)
+    for (int i = 0; i < count; i++)
     {
-    case WAVE:
-        device_wave_light(lighting, handle);
-        break;
+        workers[i].transport.correction = args->correction.enabled ? &args->correction : NULL;
+    }
 
-    case SPECTRUM:
-        device_spectrum_light(lighting, handle);
-        break;
+    // Every device gets its own worker, so the transfers of all devices are in flight at the same time.
+    for (int i = 0; i < count; i++)
+    {
+        workers[i].lighting = lighting;
 
-    case BREATHING:
-        device_breathing_light(lighting, handle);
-        break;
+        if (pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]) != 0)
+        {
+            worker_run(&workers[i]);
+            workers[i].thread = pthread_self();
+        }
+    }
 
-    case ROLLING:
-        device_rolling_light(lighting, handle);
-        break;
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!pthread_equal(workers[i].thread, pthread_self()))
+        {
+            pthread_join(workers[i].thread, NULL);
+        }
 
-    case CURVE:
-        device_curve_light(lighting, handle);
-        break;
+        if (workers[i].result < LIBUSB_SUCCESS)
+        {
+            failed++;
+        }
+        else if (args->verbose)
+        {
+            log_info("Device %i applied in %.1f ms", i, workers[i].ms);
+        }
 
-    case SCAN:
-        device_scan_light(lighting, handle);
-        break;
+        transport_close(&workers[i].transport);
+    }
 
-    case CUSTOM:
-        device_custom_light(lighting, handle);
-        break;
+    if (args->transport == TRANSPORT_LIBUSB)
+    {
+        uint64_t start = stats_now();
+        libusb_exit(NULL);
+        stats_phase_end(STATS_PHASE_CLEANUP, start);
+    }
 
-    case RADIATION:
-        device_radiation_light(lighting, handle);
-        break;
+    log_info("Applied lighting to %i of %i devices", count - failed, count);
+}
 
-    case RIPPLES:
-        device_ripples_light(lighting, handle);
-        break;
+/**
+ * @brief Sets the lighting via libusb and remembers it. With --cache it is skipped if the cache shows that the device
+ * already has it.
+ *
+ * @param args Application arguments.
+ * @param lighting The lighting to set.
+ */
+static void set_lighting_cached(args_t* args, const lighting_t* lighting)
+{
+    device_setup(args);
 
-    case SINGLE_KEY:
-        device_single_key_light(lighting, handle);
-        break;
+    libusb_device** devices;
+    struct libusb_device* dev;
+    exit_on_error(select_device(args, &devices, &dev));
 
-    case STATIC:
-        device_static_light(lighting, handle);
-        break;
+    cache_entry_t entry;
+    bool cached = cache_entry_init(&entry, dev);
+
+    if (cached && args->correction.enabled)
+    {
+        cache_entry_salt(&entry, args->correction.id);
+    }
+
+    // Nothing to do, so the device is neither opened nor the keyboard driver detached. Opt-in, as the cache cannot tell
+    // whether the keyboard changed its lighting on its own.
+    if (cached && args->cache && !args->force && !lighting->random_colors && cache_matches(&entry, lighting))
+    {
+        log_info("Device already shows the requested lighting. Use --force to apply it anyway.");
+
+        libusb_free_device_list(devices, 1);
+        libusb_exit(NULL);
+        return;
     }
 
-    device_cleanup(handle);
+    struct libusb_device_handle* handle = NULL;
+    int ret = device_open(dev, &handle);
+
+    libusb_free_device_list(devices, 1);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        log_error("Error opening device - %s\n", libusb_error_name(ret));
+    }
+
+    exit_on_error(ret);
+
+    transport_t transport;
+    transport_libusb_init(&transport, handle);
+    transport.correction = args->correction.enabled ? &args->correction : NULL;
+
+    print_args(args);
+
+    ret = device_apply_lighting(*lighting, &transport);
+
+    if (cached)
+    {
+        if (ret >= LIBUSB_SUCCESS)
+            cache_store(&entry, lighting);
+        else
+            cache_clear(&entry);
+    }
+
+    device_disconnect(&transport);
 }
 
-void device_cleanup(struct libusb_device_handle* handle)
+void device_set_lighting(args_t* args)
 {
-    perform_on_all_interfaces(handle, libusb_release_interface);
+    assert(args != NULL);
 
-    if (handle != NULL)
+    if (args->transport == TRANSPORT_LIBUSB && args->record_path == NULL)
     {
-        libusb_close(handle);
+        lighting_t lighting;
+        args_to_lighting(args, &lighting);
+
+        set_lighting_cached(args, &lighting);
+        return;
     }
 
+    transport_t transport;
+    device_connect(args, &transport);
+
+    lighting_t lighting;
+    args_to_lighting(args, &lighting);
+
+    print_args(args);
+
+    device_apply_lighting(lighting, &transport);
+
+    device_disconnect(&transport);
+}
+
+void device_cleanup(struct libusb_device_handle* handle)
+{
+    uint64_t start = stats_now();
+
+    device_close(handle);
+
     libusb_exit(NULL);
+
+    stats_phase_end(STATS_PHASE_CLEANUP, start);
 }
\ No newline at end of file
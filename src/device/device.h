@@ -25,10 +25,19 @@ SOFTWARE. */
 #include "libusb-1.0/libusb.h"
 
 #include "../args/args.h"
+#include "frame.h"
+#include "transport.h"
+#include "cache.h"
 
 #define DEFAULT_VENDOR_ID 0x046a  // Cherry GmbH
 #define DEFAULT_PRODUCT_ID 0x0079 // MX Board 3.0 s (Unknown)
 
+#define DEVICE_MAX_BOARDS 16 // Maximum number of devices handled by device_set_lighting_all
+
+#define DEVICE_RECOVER_ATTEMPTS 12      // Attempts to open a lost device again, see device_recover
+#define DEVICE_RECOVER_MIN_US 10000     // Delay before the first attempt, doubled for every further attempt
+#define DEVICE_RECOVER_MAX_US 1000000   // Maximum delay between two attempts
+
 /**
  * @brief Sets up libusb.
  *
@@ -37,109 +46,175 @@ SOFTWARE. */
 void device_setup(args_t* args);
 
 /**
- * @brief Searches for the device and sets it to operational state. If no device is found the program exits.
+ * @brief Searches for the device and sets it to operational state. Asks which one to use if several are found.
  *
  * @param args Application arguments.
+ * @param handle Receives the USB device handle.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_NOT_FOUND if no device matches or another libusb error code.
  */
-void device_find(args_t* args, struct libusb_device_handle** handle);
+int device_find(args_t* args, struct libusb_device_handle** handle);
 
 /**
- * @brief Sets STATIC lighting.
+ * @brief Opens all matching devices and claims their interfaces. Devices that cannot be opened are skipped.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param args Application arguments.
+ * @param handles Receives the USB device handles.
+ * @param max Maximum number of handles.
+ * @return int Number of opened devices or a libusb error code if the devices cannot be listed.
  */
-void device_static_light(lighting_t lighting, struct libusb_device_handle* handle);
+int device_find_all(args_t* args, struct libusb_device_handle** handles, int max);
 
 /**
- * @brief Sets WAVE lighting.
+ * @brief Opens the given device and claims all interfaces.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param dev The device.
+ * @param handleptr Receives the USB device handle.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
  */
-void device_wave_light(lighting_t lighting, struct libusb_device_handle* handle);
+int device_open(struct libusb_device* dev, struct libusb_device_handle** handleptr);
 
 /**
- * @brief Sets SPECTRUM lighting.
+ * @brief Releases all interfaces and closes the handle. libusb stays initialized.
  *
- * @param lighting Holds information about lighting.
  * @param handle USB device handle.
  */
-void device_spectrum_light(lighting_t lighting, struct libusb_device_handle* handle);
+void device_close(struct libusb_device_handle* handle);
 
 /**
- * @brief Sets BREATHING lighting.
+ * @brief Uploads per key colors. The device must be in CUSTOM mode, see device_apply_lighting.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * Only the reports covering keys that differ from the frame shown by the device are sent. If the transport has a pacing
+ * controller and a state is given, at most pacing_reports_per_frame reports are sent and the others are flagged in
+ * state->pending. If the device is lost it is recovered, see device_recover, and the whole frame is sent again unless
+ * the transport defers the recovery to the caller.
+ *
+ * @param frame The key colors.
+ * @param state The frame shown by the device. Updated after a successful upload. If NULL the whole frame is sent.
+ * @param transport The opened device.
+ * @return int Number of bytes written or a libusb error code.
  */
-void device_breathing_light(lighting_t lighting, struct libusb_device_handle* handle);
+int device_custom_frame(const frame_t* frame, frame_state_t* state, transport_t* transport);
 
 /**
- * @brief Sets ROLLING lighting.
+ * @brief Encodes the given lighting for the model of the device and sends it.
+ *
+ * CUSTOM lighting additionally sets all keys to the color of lighting, see device_custom_frame.
+ *
+ * The lighting is remembered by the transport. If the device is lost it is recovered and the lighting applied by
+ * device_recover, unless the transport defers the recovery to the caller.
  *
  * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param transport The opened device.
+ * @return int Number of bytes written, LIBUSB_SUCCESS after a recovery or a libusb error code.
  */
-void device_rolling_light(lighting_t lighting, struct libusb_device_handle* handle);
+int device_apply_lighting(lighting_t lighting, transport_t* transport);
 
 /**
- * @brief Sets CURVE lighting.
+ * @brief Progress of recovering a lost device, see device_recover_step.
+ */
+typedef struct
+{
+    int attempt;
+
+    /**
+     * @brief Microseconds to wait before the next step.
+     */
+    unsigned int delay_us;
+
+    struct timespec start;
+
+    /**
+     * @brief Per key colors sent after the lighting, NULL if there are none. Set by the caller before each step.
+     */
+    const frame_t* frame;
+    frame_state_t* state;
+
+} device_recovery_t;
+
+/**
+ * @brief Opens a lost device again and applies the lighting last applied with device_apply_lighting. Sleeps between
+ * the attempts, callers on an event loop use device_recover_start and device_recover_step instead.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * Called for LIBUSB_ERROR_NO_DEVICE, PIPE, BUSY and IO, other errors are returned unchanged. The device is looked for
+ * DEVICE_RECOVER_ATTEMPTS times with an exponential backoff. If it does not come back the transport stays lost and
+ * the next call tries again. The time it took is logged.
+ *
+ * @param transport The transport.
+ * @param error Error of the last transfer.
+ * @return int LIBUSB_SUCCESS if the device was recovered, otherwise a libusb error code.
  */
-void device_curve_light(lighting_t lighting, struct libusb_device_handle* handle);
+int device_recover(transport_t* transport, int error);
 
 /**
- * @brief Sets SCAN lighting.
+ * @brief Starts recovering the device after the given error. A device that is not lost yet is closed and the
+ * transport marked lost.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param transport The transport.
+ * @param error Error of the last transfer.
+ * @param recovery Receives the progress. The first step is due after recovery->delay_us.
+ * @return true The device is lost and has to be recovered with device_recover_step.
  */
-void device_scan_light(lighting_t lighting, struct libusb_device_handle* handle);
+bool device_recover_start(transport_t* transport, int error, device_recovery_t* recovery);
 
 /**
- * @brief Sets CUSTOM lighting.
+ * @brief Tries once to open the lost device again and to apply its lighting and recovery->frame. Does not wait.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param transport The lost transport.
+ * @param recovery The progress, see device_recover_start.
+ * @return int LIBUSB_SUCCESS if the device is back, 1 if the next step is due after recovery->delay_us or a libusb
+ * error code after DEVICE_RECOVER_ATTEMPTS attempts.
  */
-void device_custom_light(lighting_t lighting, struct libusb_device_handle* handle);
+int device_recover_step(transport_t* transport, device_recovery_t* recovery);
 
 /**
- * @brief Sets RADIATION lighting.
+ * @brief Opens the device using the transport selected in args. If no device is found the program exits.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param args Application arguments.
+ * @param transport Receives the opened device.
  */
-void device_radiation_light(lighting_t lighting, struct libusb_device_handle* handle);
+void device_connect(args_t* args, transport_t* transport);
 
 /**
- * @brief Sets RIPPLES lighting.
+ * @brief Like device_connect, but returns the cache entry of the device instead of clearing the cache.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * The caller is responsible for updating the entry after changing the lighting. Only the libusb transport is cached.
+ *
+ * @param args Application arguments.
+ * @param transport Receives the opened device.
+ * @param entry Receives the cache entry of the device.
+ * @return true entry is valid.
+ * @return false The device is not cached, the whole cache was cleared.
  */
-void device_ripples_light(lighting_t lighting, struct libusb_device_handle* handle);
+bool device_connect_cached(args_t* args, transport_t* transport, cache_entry_t* entry);
 
 /**
- * @brief Sets SINGLE KEY lighting.
+ * @brief Closes the device opened by device_connect and cleans up all resources.
  *
- * @param lighting Holds information about lighting.
- * @param handle USB device handle.
+ * @param transport The opened device.
  */
-void device_single_key_light(lighting_t lighting, struct libusb_device_handle* handle);
+void device_disconnect(transport_t* transport);
 
 /**
  * @brief Main function for setting the device lighting.
  *
+ * With the libusb transport the applied lighting is cached per device. If the device already shows the requested
+ * lighting it is not opened at all, unless args->force is set.
+ *
  * @param args Application arguments.
  * @param handle USB device handle.
  */
 void device_set_lighting(args_t* args);
 
+/**
+ * @brief Sets the lighting of all matching devices. Each device is handled by its own thread.
+ *
+ * @param args Application arguments.
+ */
+void device_set_lighting_all(args_t* args);
+
 /**
  * @brief Cleans up all resources and releases all interfaces.
+ *
+ * @param handle USB device handle. May be NULL.
  */
 void device_cleanup(struct libusb_device_handle* handle);
\ No newline at end of file
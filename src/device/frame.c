@@ -0,0 +1,166 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdlib.h"
+#include "string.h"
+
+#include "frame.h"
+#include "layout.h"
+
+void frame_init(frame_t* frame)
+{
+    if (frame == NULL)
+    {
+        return;
+    }
+
+    memset(frame, 0, sizeof(frame_t));
+}
+
+void frame_fill(frame_t* frame, rgb_t color)
+{
+    if (frame == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < FRAME_KEYS; i++)
+    {
+        frame->keys[i] = color;
+    }
+}
+
+void frame_set_key(frame_t* frame, int key, rgb_t color)
+{
+    if (frame == NULL || key < 0 || key >= FRAME_KEYS)
+    {
+        return;
+    }
+
+    frame->keys[key] = color;
+}
+
+void frame_state_init(frame_state_t* state)
+{
+    if (state == NULL)
+    {
+        return;
+    }
+
+    frame_init(&state->shown);
+    state->synced = false;
+    state->unknown = 0;
+    state->pending = 0;
+    state->next_chunk = 0;
+}
+
+uint8_t frame_changed_chunks(const frame_t* frame, const frame_state_t* state)
+{
+    uint8_t all = (1 << FRAME_CHUNKS) - 1;
+
+    if (state == NULL || !state->synced)
+    {
+        return all;
+    }
+
+    uint8_t changed = state->unknown;
+    for (int i = 0; i < FRAME_CHUNKS; i++)
+    {
+        const rgb_t* now = &frame->keys[i * FRAME_CHUNK_KEYS];
+        const rgb_t* shown = &state->shown.keys[i * FRAME_CHUNK_KEYS];
+
+        if (memcmp(now, shown, sizeof(rgb_t) * FRAME_CHUNK_KEYS) != 0)
+        {
+            changed |= 1 << i;
+        }
+    }
+
+    return changed;
+}
+
+bool frame_parse_keys(const char* str, frame_t* frame)
+{
+    if (str == NULL || frame == NULL)
+    {
+        return false;
+    }
+
+    const char* p = str;
+    while (*p != '\0')
+    {
+        char* end;
+
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        {
+            p++;
+        }
+
+        if (*p == '\0')
+        {
+            break;
+        }
+
+        long key = strtol(p, &end, 10);
+
+        // Keys can also be given by name, see layout.c.
+        if (end == p)
+        {
+            const char* eq = strchr(p, '=');
+            char name[32];
+
+            if (eq == NULL || eq - p >= (long)sizeof(name))
+            {
+                return false;
+            }
+
+            memcpy(name, p, eq - p);
+            name[eq - p] = '\0';
+
+            const layout_t* layout = layout_get();
+            int index = layout_find_name(layout, name);
+
+            key = index < 0 ? -1 : layout->led[index];
+            end = (char*)eq;
+        }
+
+        if (*end != '=' || key < 0 || key >= FRAME_KEYS)
+        {
+            return false;
+        }
+
+        p = end + 1;
+        unsigned long color = strtoul(p, &end, 16);
+        if (end - p != 6)
+        {
+            return false;
+        }
+
+        rgb_t c = { (color >> 16) & 0xff, (color >> 8) & 0xff, color & 0xff };
+        frame_set_key(frame, key, c);
+
+        p = end;
+    }
+
+    return true;
+}
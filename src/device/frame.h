@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/**
+ * @brief Number of keys that can be addressed in CUSTOM mode.
+ */
+#define FRAME_KEYS 126
+
+/**
+ * @brief Number of keys whose colors fit into one report.
+ */
+#define FRAME_CHUNK_KEYS 18
+
+/**
+ * @brief Number of reports needed for a whole frame.
+ */
+#define FRAME_CHUNKS (FRAME_KEYS / FRAME_CHUNK_KEYS)
+
+/**
+ * @brief Color of a single key.
+ */
+typedef struct
+{
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+
+} rgb_t;
+
+/**
+ * @brief Holds one color per key.
+ */
+typedef struct
+{
+    rgb_t keys[FRAME_KEYS];
+
+} frame_t;
+
+/**
+ * @brief Tracks the frame that is currently shown by the device, so only changed reports need to be sent.
+ */
+typedef struct
+{
+    frame_t shown;
+
+    /**
+     * @brief False if the shown frame is unknown, i.e. before the first upload.
+     */
+    bool synced;
+
+    /**
+     * @brief Bit mask of the reports whose keys are unknown although synced is set, because only a part of the first
+     * frame was uploaded.
+     */
+    uint8_t unknown;
+
+    /**
+     * @brief Bit mask of the changed reports of the last frame that were not sent, see pacing_reports_per_frame.
+     */
+    uint8_t pending;
+
+    /**
+     * @brief Report the next partial upload starts at, so all reports get their turn.
+     */
+    uint8_t next_chunk;
+
+} frame_state_t;
+
+/**
+ * @brief Initializes the given frame with all keys turned off.
+ *
+ * @param frame The frame.
+ */
+void frame_init(frame_t* frame);
+
+/**
+ * @brief Sets all keys of the frame to the given color.
+ *
+ * @param frame The frame.
+ * @param color The color.
+ */
+void frame_fill(frame_t* frame, rgb_t color);
+
+/**
+ * @brief Sets the color of a single key. Indices out of range are ignored.
+ *
+ * @param frame The frame.
+ * @param key Key index.
+ * @param color The color.
+ */
+void frame_set_key(frame_t* frame, int key, rgb_t color);
+
+/**
+ * @brief Initializes the given state as unsynced.
+ *
+ * @param state The state.
+ */
+void frame_state_init(frame_state_t* state);
+
+/**
+ * @brief Determines which reports of frame differ from the frame shown by the device.
+ *
+ * @param frame The frame that shall be shown.
+ * @param state The device state. If NULL or unsynced all reports are considered changed.
+ * @return uint8_t Bit mask with bit n set if report n has to be sent.
+ */
+uint8_t frame_changed_chunks(const frame_t* frame, const frame_state_t* state);
+
+/**
+ * @brief Parses key assignments of the form "INDEX=RRGGBB" or "NAME=RRGGBB" separated by whitespace into the frame.
+ *
+ * Names are the key names of the layout, i.e. "esc", "f1", "w" or "space".
+ *
+ * @param str The key assignments.
+ * @param frame The frame to modify.
+ * @return true If all assignments could be parsed.
+ */
+bool frame_parse_keys(const char* str, frame_t* frame);
@@ -0,0 +1,319 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "dirent.h"
+#include "libgen.h"
+#include "limits.h"
+#include "sys/ioctl.h"
+#include "linux/hidraw.h"
+
+#include "transport.h"
+
+#define HIDRAW_SYSFS "/sys/class/hidraw"
+
+/**
+ * @brief Interface the lighting reports are addressed to (wIndex of the SET_REPORT request).
+ */
+#define HIDRAW_INTERFACE 1
+
+/**
+ * @brief Set if the kernel does not support HIDIOCSOUTPUT and reports have to be written.
+ */
+static bool use_write = false;
+
+/**
+ * @brief Maps errno to the corresponding libusb error code.
+ *
+ * @param err The errno value.
+ * @return int The libusb error code.
+ */
+static int errno_to_libusb(int err)
+{
+    switch (err)
+    {
+    case EACCES:
+    case EPERM:
+        return LIBUSB_ERROR_ACCESS;
+
+    case ENOENT:
+    case ENODEV:
+    case ENXIO:
+        return LIBUSB_ERROR_NO_DEVICE;
+
+    case EBUSY:
+        return LIBUSB_ERROR_BUSY;
+
+    case EPIPE:
+        return LIBUSB_ERROR_PIPE;
+
+    case ETIMEDOUT:
+        return LIBUSB_ERROR_TIMEOUT;
+
+    case EINTR:
+        return LIBUSB_ERROR_INTERRUPTED;
+
+    case ENOMEM:
+        return LIBUSB_ERROR_NO_MEM;
+
+    default:
+        return LIBUSB_ERROR_IO;
+    }
+}
+
+/**
+ * @brief Reads a small sysfs file.
+ *
+ * @param path Path of the file.
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ * @return true If the file could be read.
+ */
+static bool read_file(const char* path, char* into, size_t len)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    ssize_t n = read(fd, into, len - 1);
+    close(fd);
+
+    if (n < 0)
+    {
+        return false;
+    }
+
+    into[n] = '\0';
+    return true;
+}
+
+/**
+ * @brief Reads a decimal number from a sysfs attribute of a directory.
+ *
+ * @param dir The directory.
+ * @param attribute Name of the attribute, i.e. busnum.
+ * @return long The number or -1 if it could not be read.
+ */
+static long read_number(const char* dir, const char* attribute)
+{
+    char path[PATH_MAX];
+    char buf[32];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, attribute);
+
+    if (!read_file(path, buf, sizeof(buf)))
+    {
+        return -1;
+    }
+
+    return strtol(buf, NULL, 10);
+}
+
+/**
+ * @brief Checks if the hidraw node belongs to the lighting interface of a device with the given ids.
+ *
+ * @param name Name of the node, i.e. hidraw3.
+ * @param vendor_id Vendor id.
+ * @param product_id Product id.
+ * @param bus Bus number of the USB device or 0 for any.
+ * @param address Address of the USB device or 0 for any.
+ * @return true If the node matches.
+ */
+static bool node_matches(const char* name, uint16_t vendor_id, uint16_t product_id, uint8_t bus, uint8_t address)
+{
+    char path[PATH_MAX];
+    char buf[1024];
+
+    snprintf(path, sizeof(path), HIDRAW_SYSFS "/%s/device/uevent", name);
+
+    if (!read_file(path, buf, sizeof(buf)))
+    {
+        return false;
+    }
+
+    char hid_id[64];
+    snprintf(hid_id, sizeof(hid_id), "HID_ID=0003:%08X:%08X\n", vendor_id, product_id);
+
+    if (strstr(buf, hid_id) == NULL)
+    {
+        return false;
+    }
+
+    // The HID device is a child of the USB interface, which holds the interface number.
+    snprintf(path, sizeof(path), HIDRAW_SYSFS "/%s/device", name);
+
+    char hid_dev[PATH_MAX];
+    if (realpath(path, hid_dev) == NULL)
+    {
+        return false;
+    }
+
+    char* interface = dirname(hid_dev);
+    snprintf(path, sizeof(path), "%s/bInterfaceNumber", interface);
+
+    if (!read_file(path, buf, sizeof(buf)) || strtol(buf, NULL, 16) != HIDRAW_INTERFACE)
+    {
+        return false;
+    }
+
+    if (bus == 0)
+    {
+        return true;
+    }
+
+    // The interface is a child of the USB device, which holds bus number and address.
+    char* usb_dev = dirname(interface);
+
+    return read_number(usb_dev, "busnum") == bus && read_number(usb_dev, "devnum") == address;
+}
+
+static int hidraw_send(transport_t* transport, const uint8_t* report)
+{
+    uint8_t buf[TRANSPORT_REPORT_LEN];
+    memcpy(buf, report, TRANSPORT_REPORT_LEN);
+
+#ifdef HIDIOCSOUTPUT
+    if (!use_write)
+    {
+        // Same request as the libusb transport: SET_REPORT with report type output.
+        if (ioctl(transport->fd, HIDIOCSOUTPUT(TRANSPORT_REPORT_LEN), buf) >= 0)
+        {
+            return LIBUSB_SUCCESS;
+        }
+
+        if (errno != EINVAL && errno != ENOTTY)
+        {
+            return errno_to_libusb(errno);
+        }
+
+        use_write = true;
+    }
+#endif
+
+    if (write(transport->fd, buf, TRANSPORT_REPORT_LEN) < 0)
+    {
+        return errno_to_libusb(errno);
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+static void hidraw_close(transport_t* transport)
+{
+    if (transport->fd >= 0)
+    {
+        close(transport->fd);
+        transport->fd = -1;
+    }
+}
+
+static const transport_ops_t HIDRAW_OPS = {
+    .send = hidraw_send,
+    .send_many = NULL,
+    .close = hidraw_close,
+};
+
+/**
+ * @brief Opens the n-th matching hidraw node.
+ *
+ * @param transport The transport.
+ * @param vendor_id Vendor id.
+ * @param product_id Product id.
+ * @param bus Bus number of the USB device or 0 for any.
+ * @param address Address of the USB device or 0 for any.
+ * @param index Selects the n-th matching node.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_NOT_FOUND if no node exists or LIBUSB_ERROR_ACCESS.
+ */
+static int open_node(
+    transport_t* transport, uint16_t vendor_id, uint16_t product_id, uint8_t bus, uint8_t address, int index)
+{
+    DIR* dir = opendir(HIDRAW_SYSFS);
+
+    if (dir == NULL)
+    {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    int ret = LIBUSB_ERROR_NOT_FOUND;
+    int skip = index;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, "hidraw", 6) != 0 || !node_matches(entry->d_name, vendor_id, product_id, bus, address))
+        {
+            continue;
+        }
+
+        if (skip-- > 0)
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "/dev/%s", entry->d_name);
+
+        int fd = open(path, O_RDWR | O_CLOEXEC);
+
+        if (fd < 0)
+        {
+            ret = errno_to_libusb(errno);
+            break;
+        }
+
+        memset(transport, 0, sizeof(transport_t));
+        transport->ops = &HIDRAW_OPS;
+        transport->type = TRANSPORT_HIDRAW;
+        transport->vendor_id = vendor_id;
+        transport->product_id = product_id;
+        transport->fd = fd;
+        transport->index = index;
+
+        ret = LIBUSB_SUCCESS;
+        break;
+    }
+
+    closedir(dir);
+
+    return ret;
+}
+
+int transport_hidraw_open(transport_t* transport, uint16_t vendor_id, uint16_t product_id, int index)
+{
+    return open_node(transport, vendor_id, product_id, 0, 0, index);
+}
+
+int transport_hidraw_open_device(
+    transport_t* transport, uint16_t vendor_id, uint16_t product_id, uint8_t bus, uint8_t address)
+{
+    return open_node(transport, vendor_id, product_id, bus, address, 0);
+}
@@ -0,0 +1,284 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdlib.h"
+#include "time.h"
+
+#include "hotplug.h"
+#include "device.h"
+#include "cache.h"
+#include "../log/log.h"
+#include "../loop/loop.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/**
+ * @brief Number of attempts to open an arrived device. udev may not have applied the permissions yet.
+ */
+#define OPEN_ATTEMPTS 50
+#define OPEN_RETRY_US 10000
+
+/**
+ * @brief A device that arrived and still has to be set up.
+ */
+typedef struct
+{
+    struct libusb_device* dev;
+    struct timespec arrived;
+
+    /**
+     * @brief Number of failed attempts to open the device.
+     */
+    int attempts;
+
+} arrival_t;
+
+static TRANSPORT_TYPE transport_type = TRANSPORT_LIBUSB;
+static const correction_t* correction = NULL;
+
+static arrival_t pending[HOTPLUG_MAX_PENDING];
+static int pending_count = 0;
+
+static lighting_t lighting;
+
+/**
+ * @brief Fires when the queued devices are due to be opened.
+ */
+static int open_timer = -1;
+
+static double elapsed_ms(const struct timespec* since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - since->tv_sec) * 1e3 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+/**
+ * @brief Called by libusb while handling events. Synchronous transfers must not be done in here,
+ * so the device is only queued and opened by on_open_timer.
+ */
+static int LIBUSB_CALL on_hotplug(libusb_context* ctx, libusb_device* dev, libusb_hotplug_event event, void* user_data)
+{
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT)
+    {
+        log_info("Device left - Bus: %i, Device: %i", libusb_get_bus_number(dev), libusb_get_device_address(dev));
+        return 0;
+    }
+
+    if (pending_count == ARRAY_SIZE(pending))
+    {
+        log_error("Too many devices arrived at once - Ignoring Bus: %i, Device: %i", libusb_get_bus_number(dev), libusb_get_device_address(dev));
+        return 0;
+    }
+
+    arrival_t* arrival = &pending[pending_count++];
+    arrival->dev = libusb_ref_device(dev);
+    clock_gettime(CLOCK_MONOTONIC, &arrival->arrived);
+    arrival->attempts = 0;
+
+    // Opened right after libusb returned to the loop.
+    loop_timer_set(open_timer, 1, 0);
+
+    return 0;
+}
+
+/**
+ * @brief Opens the arrived device using the selected transport.
+ *
+ * @param arrival The arrived device.
+ * @param transport Receives the opened device.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+static int open_transport(arrival_t* arrival, transport_t* transport)
+{
+    if (transport_type == TRANSPORT_HIDRAW)
+    {
+        struct libusb_device_descriptor dev_dsc;
+        int ret = libusb_get_device_descriptor(arrival->dev, &dev_dsc);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            return ret;
+        }
+
+        // Several keyboards may be connected, the node has to belong to the arrived one.
+        ret = transport_hidraw_open_device(transport, dev_dsc.idVendor, dev_dsc.idProduct,
+            libusb_get_bus_number(arrival->dev), libusb_get_device_address(arrival->dev));
+        transport->correction = correction;
+
+        return ret;
+    }
+
+    struct libusb_device_handle* handle = NULL;
+    int ret = device_open(arrival->dev, &handle);
+
+    if (ret == LIBUSB_SUCCESS)
+    {
+        transport_libusb_init(transport, handle);
+        transport->correction = correction;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Applies the lighting to the opened device and releases it again.
+ *
+ * @param arrival The arrived device.
+ * @param transport The opened device.
+ */
+static void apply(arrival_t* arrival, transport_t* transport)
+{
+    // A device lost in the meantime arrives again and is handled then, the loop does not wait for it.
+    transport->defer_recovery = true;
+
+    int ret = device_apply_lighting(lighting, transport);
+    transport_close(transport);
+
+    cache_entry_t entry;
+    if (cache_entry_init(&entry, arrival->dev))
+    {
+        if (correction != NULL)
+            cache_entry_salt(&entry, correction->id);
+
+        if (ret >= LIBUSB_SUCCESS)
+            cache_store(&entry, &lighting);
+        else
+            cache_clear(&entry);
+    }
+
+    if (ret >= LIBUSB_SUCCESS)
+    {
+        log_info("Applied %s lighting %.1f ms after arrival - Bus: %i, Device: %i",
+            lighting_mode_str(lighting.mode), elapsed_ms(&arrival->arrived),
+            libusb_get_bus_number(arrival->dev), libusb_get_device_address(arrival->dev));
+    }
+}
+
+/**
+ * @brief Tries to open every arrived device once. Devices that cannot be opened yet stay queued and the timer is armed
+ * to try again.
+ */
+static void on_open_timer(loop_t* loop, int fd, uint32_t events, void* user)
+{
+    loop_timer_read(fd);
+
+    int kept = 0;
+    for (int i = 0; i < pending_count; i++)
+    {
+        arrival_t* arrival = &pending[i];
+        transport_t transport;
+
+        int ret = open_transport(arrival, &transport);
+
+        // The hidraw node and the permissions are set up by udev shortly after the arrival.
+        bool retry = ret == LIBUSB_ERROR_ACCESS || ret == LIBUSB_ERROR_BUSY || ret == LIBUSB_ERROR_NOT_FOUND;
+
+        if (retry && ++arrival->attempts < OPEN_ATTEMPTS)
+        {
+            pending[kept++] = *arrival;
+            continue;
+        }
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            log_error("Error opening device - %s", libusb_error_name(ret));
+        }
+        else
+        {
+            apply(arrival, &transport);
+        }
+
+        libusb_unref_device(arrival->dev);
+    }
+
+    pending_count = kept;
+
+    if (pending_count > 0)
+    {
+        loop_timer_set(fd, OPEN_RETRY_US * 1000ULL, 0);
+    }
+}
+
+void hotplug_run(args_t* args)
+{
+    device_setup(args);
+
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    {
+        log_error("Hotplug is not supported on this platform - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    loop_t loop;
+    if (!loop_init(&loop) || !loop_attach_usb(&loop, NULL))
+    {
+        log_error("Error creating event loop - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    open_timer = loop_timer(&loop, on_open_timer, NULL);
+
+    if (open_timer < 0)
+    {
+        log_error("Error creating timer - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    args_to_lighting(args, &lighting);
+
+    transport_type = args->transport;
+    correction = args->correction.enabled ? &args->correction : NULL;
+
+    int vendor = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
+    int product = args->product_id != -1 ? args->product_id : DEFAULT_PRODUCT_ID;
+
+    // LIBUSB_HOTPLUG_ENUMERATE reports the devices that are already connected as arrived.
+    libusb_hotplug_callback_handle callback;
+    int ret = libusb_hotplug_register_callback(NULL,
+        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+        LIBUSB_HOTPLUG_ENUMERATE, vendor, product, LIBUSB_HOTPLUG_MATCH_ANY,
+        on_hotplug, NULL, &callback);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        log_error("Error registering hotplug callback - %s - Abort.\n", libusb_error_name(ret));
+        exit(EXIT_FAILURE);
+    }
+
+    log_info("Watching for devices %04x:%04x", vendor, product);
+
+    // Sleeps until libusb reports a device, a queued device is due to be opened again or a signal arrives.
+    loop_run(&loop);
+
+    for (int i = 0; i < pending_count; i++)
+    {
+        libusb_unref_device(pending[i].dev);
+    }
+
+    libusb_hotplug_deregister_callback(NULL, callback);
+    loop_free(&loop);
+    libusb_exit(NULL);
+}
@@ -0,0 +1,247 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stddef.h"
+#include "strings.h"
+#include "math.h"
+#include "pthread.h"
+#include "linux/input-event-codes.h"
+
+#include "layout.h"
+
+/**
+ * @brief ANSI layout of the MX Board 3.0 S.
+ *
+ * The LED index is assumed to follow the key matrix, row by row with LAYOUT_COLUMNS columns per row.
+ */
+static const layout_key_t KEYS[] = {
+    { "esc", 0, 0, 0, 0, 1, 1, KEY_ESC },
+    { "f1", 0, 1, 2, 0, 1, 1, KEY_F1 },
+    { "f2", 0, 2, 3, 0, 1, 1, KEY_F2 },
+    { "f3", 0, 3, 4, 0, 1, 1, KEY_F3 },
+    { "f4", 0, 4, 5, 0, 1, 1, KEY_F4 },
+    { "f5", 0, 5, 6.5, 0, 1, 1, KEY_F5 },
+    { "f6", 0, 6, 7.5, 0, 1, 1, KEY_F6 },
+    { "f7", 0, 7, 8.5, 0, 1, 1, KEY_F7 },
+    { "f8", 0, 8, 9.5, 0, 1, 1, KEY_F8 },
+    { "f9", 0, 9, 11, 0, 1, 1, KEY_F9 },
+    { "f10", 0, 10, 12, 0, 1, 1, KEY_F10 },
+    { "f11", 0, 11, 13, 0, 1, 1, KEY_F11 },
+    { "f12", 0, 12, 14, 0, 1, 1, KEY_F12 },
+    { "print", 0, 14, 15.25, 0, 1, 1, KEY_SYSRQ },
+    { "scrolllock", 0, 15, 16.25, 0, 1, 1, KEY_SCROLLLOCK },
+    { "pause", 0, 16, 17.25, 0, 1, 1, KEY_PAUSE },
+    { "grave", 1, 0, 0, 1.25, 1, 1, KEY_GRAVE },
+    { "1", 1, 1, 1, 1.25, 1, 1, KEY_1 },
+    { "2", 1, 2, 2, 1.25, 1, 1, KEY_2 },
+    { "3", 1, 3, 3, 1.25, 1, 1, KEY_3 },
+    { "4", 1, 4, 4, 1.25, 1, 1, KEY_4 },
+    { "5", 1, 5, 5, 1.25, 1, 1, KEY_5 },
+    { "6", 1, 6, 6, 1.25, 1, 1, KEY_6 },
+    { "7", 1, 7, 7, 1.25, 1, 1, KEY_7 },
+    { "8", 1, 8, 8, 1.25, 1, 1, KEY_8 },
+    { "9", 1, 9, 9, 1.25, 1, 1, KEY_9 },
+    { "0", 1, 10, 10, 1.25, 1, 1, KEY_0 },
+    { "minus", 1, 11, 11, 1.25, 1, 1, KEY_MINUS },
+    { "equal", 1, 12, 12, 1.25, 1, 1, KEY_EQUAL },
+    { "backspace", 1, 13, 13, 1.25, 2, 1, KEY_BACKSPACE },
+    { "insert", 1, 14, 15.25, 1.25, 1, 1, KEY_INSERT },
+    { "home", 1, 15, 16.25, 1.25, 1, 1, KEY_HOME },
+    { "pageup", 1, 16, 17.25, 1.25, 1, 1, KEY_PAGEUP },
+    { "numlock", 1, 17, 18.5, 1.25, 1, 1, KEY_NUMLOCK },
+    { "kpslash", 1, 18, 19.5, 1.25, 1, 1, KEY_KPSLASH },
+    { "kpasterisk", 1, 19, 20.5, 1.25, 1, 1, KEY_KPASTERISK },
+    { "kpminus", 1, 20, 21.5, 1.25, 1, 1, KEY_KPMINUS },
+    { "tab", 2, 0, 0, 2.25, 1.5, 1, KEY_TAB },
+    { "q", 2, 1, 1.5, 2.25, 1, 1, KEY_Q },
+    { "w", 2, 2, 2.5, 2.25, 1, 1, KEY_W },
+    { "e", 2, 3, 3.5, 2.25, 1, 1, KEY_E },
+    { "r", 2, 4, 4.5, 2.25, 1, 1, KEY_R },
+    { "t", 2, 5, 5.5, 2.25, 1, 1, KEY_T },
+    { "y", 2, 6, 6.5, 2.25, 1, 1, KEY_Y },
+    { "u", 2, 7, 7.5, 2.25, 1, 1, KEY_U },
+    { "i", 2, 8, 8.5, 2.25, 1, 1, KEY_I },
+    { "o", 2, 9, 9.5, 2.25, 1, 1, KEY_O },
+    { "p", 2, 10, 10.5, 2.25, 1, 1, KEY_P },
+    { "leftbrace", 2, 11, 11.5, 2.25, 1, 1, KEY_LEFTBRACE },
+    { "rightbrace", 2, 12, 12.5, 2.25, 1, 1, KEY_RIGHTBRACE },
+    { "backslash", 2, 13, 13.5, 2.25, 1.5, 1, KEY_BACKSLASH },
+    { "delete", 2, 14, 15.25, 2.25, 1, 1, KEY_DELETE },
+    { "end", 2, 15, 16.25, 2.25, 1, 1, KEY_END },
+    { "pagedown", 2, 16, 17.25, 2.25, 1, 1, KEY_PAGEDOWN },
+    { "kp7", 2, 17, 18.5, 2.25, 1, 1, KEY_KP7 },
+    { "kp8", 2, 18, 19.5, 2.25, 1, 1, KEY_KP8 },
+    { "kp9", 2, 19, 20.5, 2.25, 1, 1, KEY_KP9 },
+    { "kpplus", 2, 20, 21.5, 2.25, 1, 2, KEY_KPPLUS },
+    { "capslock", 3, 0, 0, 3.25, 1.75, 1, KEY_CAPSLOCK },
+    { "a", 3, 1, 1.75, 3.25, 1, 1, KEY_A },
+    { "s", 3, 2, 2.75, 3.25, 1, 1, KEY_S },
+    { "d", 3, 3, 3.75, 3.25, 1, 1, KEY_D },
+    { "f", 3, 4, 4.75, 3.25, 1, 1, KEY_F },
+    { "g", 3, 5, 5.75, 3.25, 1, 1, KEY_G },
+    { "h", 3, 6, 6.75, 3.25, 1, 1, KEY_H },
+    { "j", 3, 7, 7.75, 3.25, 1, 1, KEY_J },
+    { "k", 3, 8, 8.75, 3.25, 1, 1, KEY_K },
+    { "l", 3, 9, 9.75, 3.25, 1, 1, KEY_L },
+    { "semicolon", 3, 10, 10.75, 3.25, 1, 1, KEY_SEMICOLON },
+    { "apostrophe", 3, 11, 11.75, 3.25, 1, 1, KEY_APOSTROPHE },
+    { "enter", 3, 13, 12.75, 3.25, 2.25, 1, KEY_ENTER },
+    { "kp4", 3, 17, 18.5, 3.25, 1, 1, KEY_KP4 },
+    { "kp5", 3, 18, 19.5, 3.25, 1, 1, KEY_KP5 },
+    { "kp6", 3, 19, 20.5, 3.25, 1, 1, KEY_KP6 },
+    { "leftshift", 4, 0, 0, 4.25, 2.25, 1, KEY_LEFTSHIFT },
+    { "z", 4, 2, 2.25, 4.25, 1, 1, KEY_Z },
+    { "x", 4, 3, 3.25, 4.25, 1, 1, KEY_X },
+    { "c", 4, 4, 4.25, 4.25, 1, 1, KEY_C },
+    { "v", 4, 5, 5.25, 4.25, 1, 1, KEY_V },
+    { "b", 4, 6, 6.25, 4.25, 1, 1, KEY_B },
+    { "n", 4, 7, 7.25, 4.25, 1, 1, KEY_N },
+    { "m", 4, 8, 8.25, 4.25, 1, 1, KEY_M },
+    { "comma", 4, 9, 9.25, 4.25, 1, 1, KEY_COMMA },
+    { "dot", 4, 10, 10.25, 4.25, 1, 1, KEY_DOT },
+    { "slash", 4, 11, 11.25, 4.25, 1, 1, KEY_SLASH },
+    { "rightshift", 4, 13, 12.25, 4.25, 2.75, 1, KEY_RIGHTSHIFT },
+    { "up", 4, 15, 16.25, 4.25, 1, 1, KEY_UP },
+    { "kp1", 4, 17, 18.5, 4.25, 1, 1, KEY_KP1 },
+    { "kp2", 4, 18, 19.5, 4.25, 1, 1, KEY_KP2 },
+    { "kp3", 4, 19, 20.5, 4.25, 1, 1, KEY_KP3 },
+    { "kpenter", 4, 20, 21.5, 4.25, 1, 2, KEY_KPENTER },
+    { "leftctrl", 5, 0, 0, 5.25, 1.25, 1, KEY_LEFTCTRL },
+    { "leftmeta", 5, 1, 1.25, 5.25, 1.25, 1, KEY_LEFTMETA },
+    { "leftalt", 5, 2, 2.5, 5.25, 1.25, 1, KEY_LEFTALT },
+    { "space", 5, 6, 3.75, 5.25, 6.25, 1, KEY_SPACE },
+    { "rightalt", 5, 10, 10, 5.25, 1.25, 1, KEY_RIGHTALT },
+    { "fn", 5, 11, 11.25, 5.25, 1.25, 1, 0 },
+    { "compose", 5, 12, 12.5, 5.25, 1.25, 1, KEY_COMPOSE },
+    { "rightctrl", 5, 13, 13.75, 5.25, 1.25, 1, KEY_RIGHTCTRL },
+    { "left", 5, 14, 15.25, 5.25, 1, 1, KEY_LEFT },
+    { "down", 5, 15, 16.25, 5.25, 1, 1, KEY_DOWN },
+    { "right", 5, 16, 17.25, 5.25, 1, 1, KEY_RIGHT },
+    { "kp0", 5, 17, 18.5, 5.25, 2, 1, KEY_KP0 },
+    { "kpdot", 5, 19, 20.5, 5.25, 1, 1, KEY_KPDOT },
+};
+
+_Static_assert(sizeof(KEYS) / sizeof(KEYS[0]) <= LAYOUT_MAX_KEYS, "the layout tables must hold every key");
+
+/**
+ * @brief Distance up to which the edges of two keys count as touching, in key units.
+ */
+#define NEIGHBOUR_GAP 0.3f
+
+static layout_t layout;
+static pthread_once_t layout_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Checks if the keys touch, including diagonally.
+ */
+static int touching(const layout_key_t* a, const layout_key_t* b)
+{
+    return a->x < b->x + b->width + NEIGHBOUR_GAP && b->x < a->x + a->width + NEIGHBOUR_GAP
+        && a->y < b->y + b->height + NEIGHBOUR_GAP && b->y < a->y + a->height + NEIGHBOUR_GAP;
+}
+
+/**
+ * @brief Computes the spatial tables of the layout.
+ */
+static void layout_build()
+{
+    layout.keys = KEYS;
+    layout.count = sizeof(KEYS) / sizeof(KEYS[0]);
+
+    for (int i = 0; i < layout.count; i++)
+    {
+        const layout_key_t* key = &KEYS[i];
+
+        layout.led[i] = key->row * LAYOUT_COLUMNS + key->col;
+        layout.center_x[i] = key->x + key->width / 2;
+        layout.center_y[i] = key->y + key->height / 2;
+
+        if (key->x + key->width > layout.width)
+            layout.width = key->x + key->width;
+
+        if (key->y + key->height > layout.height)
+            layout.height = key->y + key->height;
+    }
+
+    for (int i = 0; i < layout.count; i++)
+    {
+        for (int j = 0; j < layout.count; j++)
+        {
+            float dx = layout.center_x[j] - layout.center_x[i];
+            float dy = layout.center_y[j] - layout.center_y[i];
+
+            layout.distance[i][j] = sqrtf(dx * dx + dy * dy);
+            layout.angle[i][j] = atan2f(dy, dx);
+
+            if (i != j && layout.neighbour_count[i] < LAYOUT_MAX_NEIGHBOURS && touching(&KEYS[i], &KEYS[j]))
+            {
+                layout.neighbours[i][layout.neighbour_count[i]++] = j;
+            }
+        }
+    }
+}
+
+const layout_t* layout_get()
+{
+    pthread_once(&layout_once, layout_build);
+
+    return &layout;
+}
+
+int layout_find_code(const layout_t* layout, uint16_t code)
+{
+    for (int i = 0; code != 0 && i < layout->count; i++)
+    {
+        if (layout->keys[i].code == code)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int layout_find_led(const layout_t* layout, int led)
+{
+    for (int i = 0; i < layout->count; i++)
+    {
+        if (layout->led[i] == led)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int layout_find_name(const layout_t* layout, const char* name)
+{
+    for (int i = 0; name != NULL && i < layout->count; i++)
+    {
+        if (strcasecmp(layout->keys[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,162 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+
+#include "frame.h"
+
+/**
+ * @brief Number of columns of the LED matrix. The LED index of a key is row * LAYOUT_COLUMNS + column.
+ */
+#define LAYOUT_COLUMNS 21
+
+/**
+ * @brief Number of rows of the LED matrix.
+ */
+#define LAYOUT_ROWS 6
+
+/**
+ * @brief Maximum number of keys of the layout.
+ */
+#define LAYOUT_MAX_KEYS 112
+
+/**
+ * @brief Maximum number of neighbours of a key.
+ */
+#define LAYOUT_MAX_NEIGHBOURS 12
+
+/**
+ * @brief Physical description of a single key. Positions and sizes are in key units (1 u = 19.05 mm).
+ */
+typedef struct
+{
+    const char* name;
+
+    /**
+     * @brief Position in the LED matrix.
+     */
+    uint8_t row;
+    uint8_t col;
+
+    /**
+     * @brief Top left corner.
+     */
+    float x;
+    float y;
+
+    float width;
+    float height;
+
+    /**
+     * @brief Linux input event code, see linux/input-event-codes.h.
+     */
+    uint16_t code;
+
+} layout_key_t;
+
+/**
+ * @brief Key geometry of the keyboard with precomputed spatial tables.
+ *
+ * Keys are referred to by their index in keys. Use led to address the key in a frame.
+ */
+typedef struct
+{
+    /**
+     * @brief Number of keys.
+     */
+    int count;
+
+    /**
+     * @brief The keys.
+     */
+    const layout_key_t* keys;
+
+    /**
+     * @brief Index of the key in frame_t per key.
+     */
+    uint8_t led[LAYOUT_MAX_KEYS];
+
+    /**
+     * @brief Center of every key.
+     */
+    float center_x[LAYOUT_MAX_KEYS];
+    float center_y[LAYOUT_MAX_KEYS];
+
+    /**
+     * @brief Size of the whole keyboard.
+     */
+    float width;
+    float height;
+
+    /**
+     * @brief Keys touching the key, including diagonally.
+     */
+    uint8_t neighbours[LAYOUT_MAX_KEYS][LAYOUT_MAX_NEIGHBOURS];
+    uint8_t neighbour_count[LAYOUT_MAX_KEYS];
+
+    /**
+     * @brief Distance between the centers of two keys in key units.
+     */
+    float distance[LAYOUT_MAX_KEYS][LAYOUT_MAX_KEYS];
+
+    /**
+     * @brief Direction from the first key to the second in radians, 0 pointing right and pi / 2 pointing down.
+     */
+    float angle[LAYOUT_MAX_KEYS][LAYOUT_MAX_KEYS];
+
+} layout_t;
+
+/**
+ * @brief Returns the layout of the MX Board 3.0 S. The tables are computed on the first call.
+ *
+ * @return const layout_t* The layout.
+ */
+const layout_t* layout_get();
+
+/**
+ * @brief Looks up the key of an input event code.
+ *
+ * @param layout The layout.
+ * @param code Linux input event code.
+ * @return int Index of the key or -1 if the keyboard has no such key.
+ */
+int layout_find_code(const layout_t* layout, uint16_t code);
+
+/**
+ * @brief Looks up the key of a LED index.
+ *
+ * @param layout The layout.
+ * @param led Index in frame_t.
+ * @return int Index of the key or -1 if no key is at the LED index.
+ */
+int layout_find_led(const layout_t* layout, int led);
+
+/**
+ * @brief Looks up a key by name (case insensitive), i.e. "esc", "f1", "space".
+ *
+ * @param layout The layout.
+ * @param name Name of the key.
+ * @return int Index of the key or -1 if there is no such key.
+ */
+int layout_find_name(const layout_t* layout, const char* name);
@@ -22,7 +22,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
+#include "strings.h"
 
 #include "lighting.h"
 
@@ -40,6 +43,25 @@ static char* LIGHTING_MODE_STRS[] = {
     "Static",
 };
 
+/**
+ * @brief Mode names as used on the command line and in lighting commands. Indexed by LMODE.
+ */
+static const char* LIGHTING_MODE_NAMES[] = {
+    "wave",
+    "spectrum",
+    "breathing",
+    "rolling",
+    "curve",
+    "scan",
+    "custom",
+    "radiation",
+    "ripples",
+    "single_key",
+    "static",
+};
+
+#define LIGHTING_MODE_COUNT (sizeof(LIGHTING_MODE_NAMES) / sizeof(LIGHTING_MODE_NAMES[0]))
+
 void lighting_init(lighting_t* lighting)
 {
     if (lighting == NULL)
@@ -61,4 +83,135 @@ void lighting_init(lighting_t* lighting)
 char* lighting_mode_str(LMODE mode)
 {
     return LIGHTING_MODE_STRS[mode];
-}
\ No newline at end of file
+}
+
+bool lighting_mode_parse(const char* str, LMODE* mode)
+{
+    if (str == NULL || mode == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < LIGHTING_MODE_COUNT; i++)
+    {
+        if (strcasecmp(str, LIGHTING_MODE_NAMES[i]) == 0)
+        {
+            *mode = (LMODE)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Parses an integer value and clamps it to the given range.
+ *
+ * @param str The value string.
+ * @param min Minimum value.
+ * @param max Maximum value.
+ * @param into Receives the clamped value.
+ * @return true If str is a number.
+ */
+static bool parse_clamped(const char* str, long min, long max, uint8_t* into)
+{
+    char* end = NULL;
+    long v = strtol(str, &end, 0);
+
+    if (end == str || *end != '\0')
+    {
+        return false;
+    }
+
+    if (v < min)
+    {
+        v = min;
+    }
+
+    if (v > max)
+    {
+        v = max;
+    }
+
+    *into = (uint8_t)v;
+    return true;
+}
+
+bool lighting_parse(const char* line, lighting_t* lighting)
+{
+    if (line == NULL || lighting == NULL)
+    {
+        return false;
+    }
+
+    char buf[256];
+    if (strlen(line) >= sizeof(buf))
+    {
+        return false;
+    }
+
+    strcpy(buf, line);
+
+    char* save = NULL;
+    char* tok = strtok_r(buf, " \t\r\n", &save);
+
+    if (tok == NULL || !lighting_mode_parse(tok, &lighting->mode))
+    {
+        return false;
+    }
+
+    while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+    {
+        if (strcmp(tok, "random") == 0)
+        {
+            lighting->random_colors = true;
+            continue;
+        }
+
+        char* value = strchr(tok, '=');
+        if (value == NULL)
+        {
+            return false;
+        }
+
+        *value++ = '\0';
+
+        bool ok = false;
+        if (strcmp(tok, "red") == 0)
+        {
+            ok = parse_clamped(value, 0, 255, &lighting->red);
+        }
+        else if (strcmp(tok, "green") == 0)
+        {
+            ok = parse_clamped(value, 0, 255, &lighting->green);
+        }
+        else if (strcmp(tok, "blue") == 0)
+        {
+            ok = parse_clamped(value, 0, 255, &lighting->blue);
+        }
+        else if (strcmp(tok, "speed") == 0)
+        {
+            ok = parse_clamped(value, 0, 4, &lighting->speed);
+        }
+        else if (strcmp(tok, "brightness") == 0)
+        {
+            ok = parse_clamped(value, 1, 4, &lighting->brightness);
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int lighting_format(const lighting_t* lighting, char* into, size_t len)
+{
+    return snprintf(into, len, "%s red=%u green=%u blue=%u speed=%u brightness=%u%s",
+        LIGHTING_MODE_NAMES[lighting->mode],
+        lighting->red, lighting->green, lighting->blue,
+        lighting->speed, lighting->brightness,
+        lighting->random_colors ? " random" : "");
+}
@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include "stdint.h"
 #include "stdbool.h"
+#include "stddef.h"
 
 /**
  * @brief Defines how colors are displayed on the keyboard. I.e. STATIC, WAVE, BREATHING, CURVE etc.
@@ -78,4 +79,36 @@ void lighting_init(lighting_t* lighting);
  * @param mode The mode to decode.
  * @return char* The string representation of the given mode.
  */
-char* lighting_mode_str(LMODE mode);
\ No newline at end of file
+char* lighting_mode_str(LMODE mode);
+
+/**
+ * @brief Parses the given lighting mode name (case insensitive).
+ *
+ * @param str The mode name. I.e. "static", "wave", "single_key" etc.
+ * @param mode Receives the parsed mode.
+ * @return true If the name is a known lighting mode.
+ */
+bool lighting_mode_parse(const char* str, LMODE* mode);
+
+/**
+ * @brief Parses a textual lighting command.
+ *
+ * A command consists of the mode name followed by optional key=value pairs and flags, i.e.
+ * "static red=255 green=0 blue=0 brightness=4" or "wave speed=0 random". Values that are not
+ * given keep the value they have in lighting.
+ *
+ * @param line The command. Trailing newlines are ignored.
+ * @param lighting Receives the parsed values.
+ * @return true If the command could be parsed.
+ */
+bool lighting_parse(const char* line, lighting_t* lighting);
+
+/**
+ * @brief Formats the given lighting as a command that can be read by lighting_parse.
+ *
+ * @param lighting Holds information about lighting.
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ * @return int Number of characters that would have been written, see snprintf.
+ */
+int lighting_format(const lighting_t* lighting, char* into, size_t len);
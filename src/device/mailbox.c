@@ -0,0 +1,78 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "string.h"
+
+#include "mailbox.h"
+
+#define MAILBOX_INDEX 3u
+#define MAILBOX_FRESH 4u
+
+void mailbox_init(mailbox_t* mailbox)
+{
+    memset(mailbox, 0, sizeof(mailbox_t));
+
+    for (int i = 0; i < 3; i++)
+    {
+        frame_init(&mailbox->slots[i].frame);
+    }
+
+    mailbox->back = 0;
+    atomic_init(&mailbox->middle, 1);
+    mailbox->front = 2;
+    atomic_init(&mailbox->published, 0);
+    atomic_init(&mailbox->dropped, 0);
+}
+
+mailbox_slot_t* mailbox_back(mailbox_t* mailbox)
+{
+    return &mailbox->slots[mailbox->back];
+}
+
+bool mailbox_publish(mailbox_t* mailbox)
+{
+    unsigned int previous = atomic_exchange_explicit(&mailbox->middle, mailbox->back | MAILBOX_FRESH, memory_order_acq_rel);
+
+    mailbox->back = previous & MAILBOX_INDEX;
+    atomic_fetch_add_explicit(&mailbox->published, 1, memory_order_relaxed);
+
+    if ((previous & MAILBOX_FRESH) != 0)
+    {
+        atomic_fetch_add_explicit(&mailbox->dropped, 1, memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+const mailbox_slot_t* mailbox_take(mailbox_t* mailbox)
+{
+    if ((atomic_load_explicit(&mailbox->middle, memory_order_relaxed) & MAILBOX_FRESH) == 0)
+    {
+        return NULL;
+    }
+
+    unsigned int previous = atomic_exchange_explicit(&mailbox->middle, mailbox->front, memory_order_acq_rel);
+    mailbox->front = previous & MAILBOX_INDEX;
+
+    return &mailbox->slots[mailbox->front];
+}
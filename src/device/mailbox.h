@@ -0,0 +1,102 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stdatomic.h"
+
+#include "frame.h"
+
+/**
+ * @brief A frame in the mailbox.
+ */
+typedef struct
+{
+    frame_t frame;
+
+    /**
+     * @brief Monotonic time in nanoseconds the frame is measured from, i.e. a key press. 0 if not measured.
+     */
+    uint64_t stamp;
+
+} mailbox_slot_t;
+
+/**
+ * @brief Lock-free triple buffer handing frames from one writer thread to one reader thread. The newest published
+ * frame wins, frames the reader did not take in time are dropped.
+ */
+typedef struct
+{
+    mailbox_slot_t slots[3];
+
+    /**
+     * @brief Index of the slot between writer and reader, with MAILBOX_FRESH set if it was not taken yet.
+     */
+    _Atomic unsigned int middle;
+
+    /**
+     * @brief Slot owned by the writer.
+     */
+    unsigned int back;
+
+    /**
+     * @brief Slot owned by the reader.
+     */
+    unsigned int front;
+
+    atomic_ulong published;
+    atomic_ulong dropped;
+
+} mailbox_t;
+
+/**
+ * @brief Initializes an empty mailbox.
+ *
+ * @param mailbox The mailbox.
+ */
+void mailbox_init(mailbox_t* mailbox);
+
+/**
+ * @brief Returns the slot the writer fills next. It holds an older frame.
+ *
+ * @param mailbox The mailbox.
+ * @return mailbox_slot_t* The slot, owned by the writer until mailbox_publish.
+ */
+mailbox_slot_t* mailbox_back(mailbox_t* mailbox);
+
+/**
+ * @brief Publishes the slot returned by mailbox_back. Called by the writer.
+ *
+ * @param mailbox The mailbox.
+ * @return true The previous frame was not taken and is dropped. mailbox_back now returns its slot.
+ */
+bool mailbox_publish(mailbox_t* mailbox);
+
+/**
+ * @brief Takes the newest published frame. Called by the reader.
+ *
+ * @param mailbox The mailbox.
+ * @return const mailbox_slot_t* The slot, owned by the reader until the next call. NULL if no new frame was published.
+ */
+const mailbox_slot_t* mailbox_take(mailbox_t* mailbox);
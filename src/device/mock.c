@@ -0,0 +1,193 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+
+#include "transport.h"
+#include "../log/log.h"
+
+#define MOCK_INITIAL_CAPACITY 64
+
+/**
+ * @brief A transfer received by the mock device.
+ */
+typedef struct
+{
+    struct timespec time;
+    uint8_t report[TRANSPORT_REPORT_LEN];
+    int result;
+
+} mock_transfer_t;
+
+struct mock_device
+{
+    mock_config_t config;
+
+    struct timespec opened;
+
+    mock_transfer_t* transfers;
+    size_t count;
+    size_t capacity;
+};
+
+static long long elapsed_us(const struct timespec* since, const struct timespec* until)
+{
+    return (until->tv_sec - since->tv_sec) * 1000000LL + (until->tv_nsec - since->tv_nsec) / 1000;
+}
+
+static int mock_send(transport_t* transport, const uint8_t* report)
+{
+    struct mock_device* mock = transport->mock;
+
+    if (mock->count == mock->capacity)
+    {
+        size_t capacity = mock->capacity * 2;
+        mock_transfer_t* transfers = realloc(mock->transfers, capacity * sizeof(mock_transfer_t));
+
+        if (transfers == NULL)
+        {
+            return LIBUSB_ERROR_NO_MEM;
+        }
+
+        mock->transfers = transfers;
+        mock->capacity = capacity;
+    }
+
+    mock_transfer_t* transfer = &mock->transfers[mock->count++];
+
+    clock_gettime(CLOCK_MONOTONIC, &transfer->time);
+    memcpy(transfer->report, report, TRANSPORT_REPORT_LEN);
+
+    if (mock->config.latency_us > 0)
+    {
+        struct timespec latency = { mock->config.latency_us / 1000000, (mock->config.latency_us % 1000000) * 1000 };
+
+        while (nanosleep(&latency, &latency) < 0 && errno == EINTR)
+        {
+        }
+    }
+
+    transfer->result = LIBUSB_SUCCESS;
+
+    if (mock->config.fail_every > 0 && mock->count % mock->config.fail_every == 0)
+    {
+        transfer->result = mock->config.error;
+    }
+
+    return transfer->result;
+}
+
+static void mock_close(transport_t* transport)
+{
+    struct mock_device* mock = transport->mock;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < mock->count; i++)
+    {
+        if (mock->transfers[i].result < LIBUSB_SUCCESS)
+        {
+            failed++;
+        }
+    }
+
+    struct timespec closed;
+    clock_gettime(CLOCK_MONOTONIC, &closed);
+
+    if (mock->config.quiet)
+    {
+        // Nothing to report, the caller consumes the transfers itself.
+    }
+    else if (mock->count > 0)
+    {
+        log_info("Mock device: %zu transfers (%zu failed), %zu bytes, first after %lld us, last after %lld us, closed after %lld us",
+            mock->count, failed, mock->count * TRANSPORT_REPORT_LEN,
+            elapsed_us(&mock->opened, &mock->transfers[0].time),
+            elapsed_us(&mock->opened, &mock->transfers[mock->count - 1].time),
+            elapsed_us(&mock->opened, &closed));
+    }
+    else
+    {
+        log_info("Mock device: no transfers, closed after %lld us", elapsed_us(&mock->opened, &closed));
+    }
+
+    free(mock->transfers);
+    free(mock);
+    transport->mock = NULL;
+}
+
+static const transport_ops_t MOCK_OPS = {
+    .send = mock_send,
+    .send_many = NULL,
+    .close = mock_close,
+};
+
+size_t transport_mock_count(const transport_t* transport)
+{
+    return transport->type == TRANSPORT_MOCK && transport->mock != NULL ? transport->mock->count : 0;
+}
+
+bool transport_mock_report(const transport_t* transport, size_t index, uint8_t* report)
+{
+    if (index >= transport_mock_count(transport))
+    {
+        return false;
+    }
+
+    memcpy(report, transport->mock->transfers[index].report, TRANSPORT_REPORT_LEN);
+    return true;
+}
+
+int transport_mock_open(transport_t* transport, const mock_config_t* config)
+{
+    struct mock_device* mock = calloc(1, sizeof(struct mock_device));
+
+    if (mock == NULL)
+    {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    mock->transfers = malloc(MOCK_INITIAL_CAPACITY * sizeof(mock_transfer_t));
+
+    if (mock->transfers == NULL)
+    {
+        free(mock);
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    mock->capacity = MOCK_INITIAL_CAPACITY;
+    mock->config = *config;
+    clock_gettime(CLOCK_MONOTONIC, &mock->opened);
+
+    memset(transport, 0, sizeof(transport_t));
+    transport->ops = &MOCK_OPS;
+    transport->type = TRANSPORT_MOCK;
+    transport->vendor_id = 0x046a;
+    transport->product_id = 0x0079;
+    transport->fd = -1;
+    transport->mock = mock;
+
+    return LIBUSB_SUCCESS;
+}
@@ -0,0 +1,84 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stddef.h"
+
+#include "pacing.h"
+#include "frame.h"
+#include "../log/log.h"
+
+#define PACING_SMOOTHING 8 // Weight of the average against a new measurement
+
+void pacing_init(pacing_t* pacing, unsigned int target_us, unsigned int max_fps, bool verbose)
+{
+    pacing->target_ns = (uint64_t)target_us * 1000;
+    pacing->max_fps = max_fps > 0 ? max_fps : 1;
+    pacing->verbose = verbose;
+
+    atomic_init(&pacing->report_ns, 0);
+    atomic_init(&pacing->reports_per_frame, FRAME_CHUNKS);
+    atomic_init(&pacing->fps, pacing->max_fps);
+}
+
+void pacing_observe(pacing_t* pacing, int reports, uint64_t ns)
+{
+    if (reports <= 0)
+    {
+        return;
+    }
+
+    // Only the sending thread observes, the others just read the results.
+    uint64_t sample = ns / reports;
+    uint64_t average = atomic_load_explicit(&pacing->report_ns, memory_order_relaxed);
+
+    average = average == 0 ? sample : (average * (PACING_SMOOTHING - 1) + sample) / PACING_SMOOTHING;
+    average = average > 0 ? average : 1;
+    atomic_store_explicit(&pacing->report_ns, average, memory_order_relaxed);
+
+    uint64_t fit = pacing->target_ns / average;
+    int reports_per_frame = fit < 1 ? 1 : fit > FRAME_CHUNKS ? FRAME_CHUNKS : (int)fit;
+
+    uint64_t frame_ns = reports_per_frame * average;
+    uint64_t device_fps = 1000000000ULL / frame_ns;
+    unsigned int fps = device_fps < 1 ? 1 : device_fps < pacing->max_fps ? (unsigned int)device_fps : pacing->max_fps;
+
+    int previous_reports = atomic_exchange_explicit(&pacing->reports_per_frame, reports_per_frame, memory_order_relaxed);
+    unsigned int previous_fps = atomic_exchange_explicit(&pacing->fps, fps, memory_order_relaxed);
+
+    // Small changes of the frame rate are not worth a message.
+    bool changed = previous_reports != reports_per_frame || fps * 10 < previous_fps * 9 || fps * 9 > previous_fps * 10;
+
+    if (pacing->verbose && changed)
+    {
+        log_info("Pacing: %.0f us per report, %i reports per frame at %u fps", average / 1e3, reports_per_frame, fps);
+    }
+}
+
+int pacing_reports_per_frame(const pacing_t* pacing)
+{
+    return pacing != NULL ? atomic_load_explicit(&pacing->reports_per_frame, memory_order_relaxed) : FRAME_CHUNKS;
+}
+
+unsigned int pacing_fps(const pacing_t* pacing, unsigned int fps)
+{
+    return pacing != NULL ? atomic_load_explicit(&pacing->fps, memory_order_relaxed) : fps;
+}
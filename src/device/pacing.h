@@ -0,0 +1,88 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stdatomic.h"
+
+#define PACING_DEFAULT_TARGET_US 16000 // Target time for uploading a frame, one frame at 60 Hz
+
+/**
+ * @brief Adapts the frame rate and the number of reports per frame of streamed effects to the measured transfer times.
+ *
+ * The transport reports the completion time of every report. From the average time per report the controller picks
+ * as many reports per frame as fit into the target latency, and the highest frame rate the device can take at that
+ * size. Reports that do not fit into a frame are sent with the next one.
+ */
+typedef struct pacing
+{
+    uint64_t target_ns;
+    unsigned int max_fps;
+    bool verbose;
+
+    /**
+     * @brief Moving average of the time per report in nanoseconds, 0 until the first report completed.
+     */
+    atomic_uint_fast64_t report_ns;
+
+    atomic_int reports_per_frame;
+    atomic_uint fps;
+
+} pacing_t;
+
+/**
+ * @brief Initializes the controller. Until the first report completed full frames are sent at max_fps.
+ *
+ * @param pacing The controller.
+ * @param target_us Time uploading a frame may take in microseconds.
+ * @param max_fps Frame rate requested by the effect.
+ * @param verbose Log the chosen rate whenever it changes.
+ */
+void pacing_init(pacing_t* pacing, unsigned int target_us, unsigned int max_fps, bool verbose);
+
+/**
+ * @brief Adds the completion time of sent reports. Called by the transport.
+ *
+ * @param pacing The controller.
+ * @param reports Number of reports.
+ * @param ns Time until all reports completed in nanoseconds.
+ */
+void pacing_observe(pacing_t* pacing, int reports, uint64_t ns);
+
+/**
+ * @brief Returns the number of reports that may be sent per frame.
+ *
+ * @param pacing The controller or NULL.
+ * @return int Number of reports, FRAME_CHUNKS without controller.
+ */
+int pacing_reports_per_frame(const pacing_t* pacing);
+
+/**
+ * @brief Returns the frame rate effects shall render at.
+ *
+ * @param pacing The controller or NULL.
+ * @param fps Frame rate requested by the effect, returned without controller.
+ * @return unsigned int Frames per second.
+ */
+unsigned int pacing_fps(const pacing_t* pacing, unsigned int fps);
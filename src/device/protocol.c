@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "string.h"
+#include "assert.h"
+
+#include "protocol.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/**
+ * @brief Defines a mode descriptor. The template holds the given opcode, mode and the values of all
+ * parameters that are not stamped for this mode.
+ */
+#define MODE(opcode, mode, flags, speed, random, red, green, blue)                   \
+    {                                                                                \
+        true, flags,                                                                 \
+        {                                                                            \
+            [0] = 0x04, [1] = opcode, [2] = 0x03, [3] = 0x06, [4] = 0x09, [7] = 0x55, \
+            [9] = mode, [11] = speed, [13] = random, [14] = red, [15] = green,       \
+            [16] = blue,                                                             \
+        }                                                                            \
+    }
+
+/**
+ * @brief Flags of the modes taking all parameters.
+ */
+#define ANIMATED (PROTOCOL_SPEED_OPCODE | PROTOCOL_SPEED | PROTOCOL_RANDOM | PROTOCOL_COLOR)
+
+static const protocol_model_t MODELS[] = {
+    {
+        .vendor_id = 0x046a,  // Cherry GmbH
+        .product_id = 0x0079, // MX Board 3.0 S
+        .name = "MX Board 3.0 S",
+        .modes = {
+            [WAVE] = MODE(0x65, 0x00, ANIMATED, 0, 0, 0, 0, 0),
+            [SPECTRUM] = MODE(0x66, 0x01, ANIMATED, 0, 0, 0, 0, 0),
+            [BREATHING] = MODE(0x67, 0x02, ANIMATED, 0, 0, 0, 0, 0),
+            [ROLLING] = MODE(0x6f, 0x0a, PROTOCOL_SPEED_OPCODE | PROTOCOL_SPEED, 0, 0x01, 0xff, 0xff, 0xff),
+            [CURVE] = MODE(0x71, 0x0c, ANIMATED, 0, 0, 0, 0, 0),
+            [SCAN] = MODE(0x71, 0x0f, ANIMATED, 0, 0, 0, 0, 0),
+            [CUSTOM] = MODE(0x00, 0x08, PROTOCOL_SPEED | PROTOCOL_CHECKSUM, 0, 0, 0, 0, 0),
+            [RADIATION] = MODE(0x77, 0x12, ANIMATED, 0, 0, 0, 0, 0),
+            [RIPPLES] = MODE(0x78, 0x13, ANIMATED, 0, 0, 0, 0, 0),
+            [SINGLE_KEY] = MODE(0x7a, 0x15, ANIMATED, 0, 0, 0, 0, 0),
+            [STATIC] = MODE(0x69, 0x03, PROTOCOL_COLOR, 0x02, 0, 0, 0, 0),
+        },
+    },
+};
+
+/**
+ * @brief Writes the checksum of the report into bytes 1 and 2. The checksum is the sum of all bytes following it.
+ *
+ * @param data The report.
+ */
+static void set_checksum(uint8_t* data)
+{
+    uint16_t sum = 0;
+
+    for (int i = 3; i < PROTOCOL_REPORT_LEN; i++)
+    {
+        sum += data[i];
+    }
+
+    data[1] = sum & 0xff;
+    data[2] = sum >> 8;
+}
+
+const protocol_model_t* protocol_find_model(uint16_t vendor_id, uint16_t product_id)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(MODELS); i++)
+    {
+        if (MODELS[i].vendor_id == vendor_id && MODELS[i].product_id == product_id)
+        {
+            return &MODELS[i];
+        }
+    }
+
+    return NULL;
+}
+
+const protocol_model_t* protocol_default_model()
+{
+    return &MODELS[0];
+}
+
+bool protocol_encode(const protocol_model_t* model, const lighting_t* lighting, uint8_t* into)
+{
+    assert(model != NULL);
+    assert(lighting != NULL);
+    assert(into != NULL);
+
+    if (lighting->mode >= PROTOCOL_MODES || !model->modes[lighting->mode].supported)
+    {
+        return false;
+    }
+
+    const protocol_mode_t* mode = &model->modes[lighting->mode];
+
+    memcpy(into, mode->template, PROTOCOL_REPORT_LEN);
+
+    into[10] = lighting->brightness;
+
+    if (mode->flags & PROTOCOL_SPEED_OPCODE)
+    {
+        into[1] += lighting->speed;
+    }
+
+    if (mode->flags & PROTOCOL_SPEED)
+    {
+        into[11] = lighting->speed;
+    }
+
+    if (mode->flags & PROTOCOL_RANDOM)
+    {
+        into[13] = lighting->random_colors;
+    }
+
+    if (mode->flags & PROTOCOL_COLOR)
+    {
+        into[14] = lighting->red;
+        into[15] = lighting->green;
+        into[16] = lighting->blue;
+    }
+
+    if (mode->flags & PROTOCOL_CHECKSUM)
+    {
+        set_checksum(into);
+    }
+
+    return true;
+}
+
+void protocol_encode_chunk(const frame_t* frame, int chunk, uint8_t* into)
+{
+    assert(frame != NULL);
+    assert(chunk >= 0 && chunk < FRAME_CHUNKS);
+
+    uint16_t offset = chunk * FRAME_CHUNK_KEYS * sizeof(rgb_t);
+
+    memset(into, 0, PROTOCOL_REPORT_LEN);
+
+    into[0] = 0x04;
+    into[3] = 0x0b;
+    into[4] = FRAME_CHUNK_KEYS * sizeof(rgb_t);
+    into[5] = offset & 0xff;
+    into[6] = offset >> 8;
+
+    memcpy(&into[8], &frame->keys[chunk * FRAME_CHUNK_KEYS], FRAME_CHUNK_KEYS * sizeof(rgb_t));
+    set_checksum(into);
+}
@@ -0,0 +1,140 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#include "lighting.h"
+#include "frame.h"
+
+/**
+ * @brief Size of a single report.
+ */
+#define PROTOCOL_REPORT_LEN 64
+
+/**
+ * @brief Number of lighting modes, see LMODE.
+ */
+#define PROTOCOL_MODES (STATIC + 1)
+
+/**
+ * @brief The speed is added to the opcode in byte 1.
+ */
+#define PROTOCOL_SPEED_OPCODE 0x01
+
+/**
+ * @brief The speed is stored in byte 11.
+ */
+#define PROTOCOL_SPEED 0x02
+
+/**
+ * @brief The random colors flag is stored in byte 13.
+ */
+#define PROTOCOL_RANDOM 0x04
+
+/**
+ * @brief The color is stored in bytes 14 - 16.
+ */
+#define PROTOCOL_COLOR 0x08
+
+/**
+ * @brief Bytes 1 and 2 hold the checksum of the report instead of an opcode.
+ */
+#define PROTOCOL_CHECKSUM 0x10
+
+/**
+ * @brief Describes how a lighting mode is encoded.
+ */
+typedef struct
+{
+    /**
+     * @brief False if the model does not support the mode.
+     */
+    bool supported;
+
+    /**
+     * @brief Combination of the PROTOCOL_* flags defining which parameters are stamped into the template.
+     */
+    uint8_t flags;
+
+    /**
+     * @brief The report with all fixed bytes set.
+     */
+    uint8_t template[PROTOCOL_REPORT_LEN];
+
+} protocol_mode_t;
+
+/**
+ * @brief Describes a keyboard model.
+ */
+typedef struct
+{
+    uint16_t vendor_id;
+    uint16_t product_id;
+
+    const char* name;
+
+    /**
+     * @brief Mode descriptors indexed by LMODE.
+     */
+    protocol_mode_t modes[PROTOCOL_MODES];
+
+} protocol_model_t;
+
+/**
+ * @brief Looks up the model with the given ids.
+ *
+ * @param vendor_id Vendor id.
+ * @param product_id Product id.
+ * @return const protocol_model_t* The model or NULL if the ids are unknown.
+ */
+const protocol_model_t* protocol_find_model(uint16_t vendor_id, uint16_t product_id);
+
+/**
+ * @brief Returns the model used for devices with unknown ids.
+ *
+ * @return const protocol_model_t* The MX Board 3.0 S model.
+ */
+const protocol_model_t* protocol_default_model();
+
+/**
+ * @brief Encodes the report setting the given lighting.
+ *
+ * @param model The keyboard model.
+ * @param lighting Holds information about lighting.
+ * @param into Receives the report. Must hold PROTOCOL_REPORT_LEN bytes.
+ * @return true If the model supports the lighting mode.
+ */
+bool protocol_encode(const protocol_model_t* model, const lighting_t* lighting, uint8_t* into);
+
+/**
+ * @brief Encodes the report holding the key colors of one chunk of the frame.
+ *
+ * @param frame The frame.
+ * @param chunk Index of the chunk.
+ * @param into Receives the report. Must hold PROTOCOL_REPORT_LEN bytes.
+ */
+void protocol_encode_chunk(const frame_t* frame, int chunk, uint8_t* into);
@@ -0,0 +1,150 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+
+#include "replay.h"
+#include "device.h"
+#include "../log/log.h"
+
+/**
+ * @brief Parses a line of a recording.
+ *
+ * @param line The line.
+ * @param us Receives the time of the report in microseconds.
+ * @param report Receives the report.
+ * @return true If the line is valid.
+ */
+static bool parse_line(const char* line, long long* us, uint8_t* report)
+{
+    char* end;
+    *us = strtoll(line, &end, 10);
+
+    if (end == line || *end != ' ')
+    {
+        return false;
+    }
+
+    const char* hex = end + 1;
+    for (int i = 0; i < TRANSPORT_REPORT_LEN; i++)
+    {
+        unsigned int byte;
+
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+        {
+            return false;
+        }
+
+        report[i] = byte;
+    }
+
+    return true;
+}
+
+static void add_us(struct timespec* ts, long long us)
+{
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (us % 1000000) * 1000;
+
+    if (ts->tv_nsec >= 1000000000)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+void replay_run(args_t* args)
+{
+    FILE* file = fopen(args->replay_path, "r");
+
+    if (file == NULL)
+    {
+        log_error("Error opening %s - %s - Abort.\n", args->replay_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char line[TRANSPORT_REPORT_LEN * 2 + 64];
+    int lineno = 0;
+    int sent = 0;
+    int failed = 0;
+    long long late_max = 0;
+    long long late_sum = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        lineno++;
+
+        long long us;
+        uint8_t report[TRANSPORT_REPORT_LEN];
+
+        if (!parse_line(line, &us, report))
+        {
+            log_error("Invalid report in line %i of %s", lineno, args->replay_path);
+            continue;
+        }
+
+        struct timespec due = start;
+        add_us(&due, us);
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+        {
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        long long late = (now.tv_sec - due.tv_sec) * 1000000LL + (now.tv_nsec - due.tv_nsec) / 1000;
+        late_sum += late;
+        late_max = late > late_max ? late : late_max;
+
+        int ret = transport_send(&transport, report);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            log_error("Error sending report of line %i - %s", lineno, libusb_error_name(ret));
+            failed++;
+        }
+
+        sent++;
+    }
+
+    fclose(file);
+
+    if (sent > 0)
+    {
+        log_info("Replayed %i reports (%i failed), mean delay %lld us, max delay %lld us", sent, failed, late_sum / sent, late_max);
+    }
+
+    device_disconnect(&transport);
+}
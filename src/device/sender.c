@@ -0,0 +1,178 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "errno.h"
+#include "signal.h"
+
+#include "sender.h"
+#include "device.h"
+
+/**
+ * @brief Uploads a frame taken from the mailbox.
+ *
+ * @param sender The sender.
+ * @param slot The frame.
+ * @return int Number of bytes written or a libusb error code.
+ */
+static int upload(sender_t* sender, const mailbox_slot_t* slot)
+{
+    // Set by the first transfer of the frame, after correction and delta encoding.
+    sender->transport->issued = 0;
+
+    int ret = device_custom_frame(&slot->frame, &sender->shown, sender->transport);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        return ret;
+    }
+
+    atomic_fetch_add_explicit(&sender->sent, 1, memory_order_relaxed);
+
+    // A frame without changes issues no transfer, so there is no latency to measure.
+    if (slot->stamp != 0 && sender->on_sent != NULL && sender->transport->issued != 0)
+    {
+        sender->on_sent(sender->user, slot->stamp, sender->transport->issued);
+    }
+
+    return ret;
+}
+
+static void* sender_run(void* arg)
+{
+    sender_t* sender = arg;
+
+    while (1)
+    {
+        while (sem_wait(&sender->wake) != 0 && errno == EINTR)
+            ;
+
+        const mailbox_slot_t* slot = mailbox_take(&sender->mailbox);
+
+        if (slot == NULL)
+        {
+            // Woken for a frame that was taken already, or to stop after everything was sent.
+            if (atomic_load(&sender->stopping))
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        int ret = upload(sender, slot);
+
+        // Completes a frame that did not fit into one upload. A newer frame takes its place if there is one.
+        while (ret >= LIBUSB_SUCCESS && sender->shown.pending != 0)
+        {
+            const mailbox_slot_t* newer = mailbox_take(&sender->mailbox);
+
+            if (newer != NULL)
+            {
+                slot = newer;
+                ret = upload(sender, slot);
+            }
+            else
+            {
+                ret = device_custom_frame(&slot->frame, &sender->shown, sender->transport);
+            }
+        }
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            atomic_store(&sender->error, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+bool sender_start(sender_t* sender, transport_t* transport, pacing_t* pacing, sender_sent_t on_sent, void* user)
+{
+    sender->transport = transport;
+    sender->on_sent = on_sent;
+    sender->user = user;
+    sender->pacing = pacing;
+
+    mailbox_init(&sender->mailbox);
+    frame_state_init(&sender->shown);
+
+    atomic_init(&sender->stopping, false);
+    atomic_init(&sender->error, LIBUSB_SUCCESS);
+    atomic_init(&sender->sent, 0);
+
+    if (sem_init(&sender->wake, 0, 0) != 0)
+    {
+        return false;
+    }
+
+    transport->pacing = pacing;
+
+    // The sending thread must not take signals meant for the rendering thread.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    int ret = pthread_create(&sender->thread, NULL, sender_run, sender);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0)
+    {
+        transport->pacing = NULL;
+        sem_destroy(&sender->wake);
+        return false;
+    }
+
+    return true;
+}
+
+mailbox_slot_t* sender_frame(sender_t* sender)
+{
+    return mailbox_back(&sender->mailbox);
+}
+
+bool sender_submit(sender_t* sender)
+{
+    bool dropped = mailbox_publish(&sender->mailbox);
+    sem_post(&sender->wake);
+
+    return dropped;
+}
+
+int sender_error(sender_t* sender)
+{
+    return atomic_load(&sender->error);
+}
+
+int sender_stop(sender_t* sender)
+{
+    atomic_store(&sender->stopping, true);
+    sem_post(&sender->wake);
+
+    pthread_join(sender->thread, NULL);
+    sem_destroy(&sender->wake);
+
+    sender->transport->pacing = NULL;
+
+    return atomic_load(&sender->error);
+}
@@ -0,0 +1,131 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "pthread.h"
+#include "semaphore.h"
+
+#include "mailbox.h"
+#include "pacing.h"
+#include "transport.h"
+
+/**
+ * @brief Called by the sending thread for every sent frame that has a stamp.
+ *
+ * @param user User data given to sender_start.
+ * @param stamp Stamp of the frame, see mailbox_slot_t.
+ * @param issued Monotonic time in nanoseconds the first transfer of the frame was issued. Frames that needed no
+ * transfer are not passed.
+ */
+typedef void (*sender_sent_t)(void* user, uint64_t stamp, uint64_t issued);
+
+/**
+ * @brief Uploads per key frames on a separate thread, so a slow transfer does not hold up rendering.
+ *
+ * The rendering thread fills sender_frame and hands it over with sender_submit. The sending thread always uploads the
+ * newest frame with device_custom_frame, frames submitted while a transfer is running are dropped. With pacing, a frame
+ * whose reports do not fit into one upload is completed by the following uploads unless a newer frame arrives.
+ */
+typedef struct
+{
+    transport_t* transport;
+
+    mailbox_t mailbox;
+
+    /**
+     * @brief The frame shown by the device, only used by the sending thread.
+     */
+    frame_state_t shown;
+
+    /**
+     * @brief Posted for every submitted frame and when stopping.
+     */
+    sem_t wake;
+
+    pthread_t thread;
+
+    atomic_bool stopping;
+
+    /**
+     * @brief First libusb error of an upload. The sending thread stops after an error.
+     */
+    atomic_int error;
+
+    /**
+     * @brief Number of frames whose upload started. With pacing a newer frame may replace one before it is complete.
+     */
+    atomic_ulong sent;
+
+    sender_sent_t on_sent;
+    void* user;
+
+    /**
+     * @brief Controller attached to the transport while the thread runs. NULL if disabled.
+     */
+    pacing_t* pacing;
+
+} sender_t;
+
+/**
+ * @brief Starts the sending thread. The device must be in CUSTOM mode.
+ *
+ * @param sender The sender.
+ * @param transport The opened device. Must not be used by other threads until sender_stop.
+ * @param pacing Controller adapting the uploads to the measured transfer times, see pacing_init. May be NULL.
+ * @param on_sent Called for sent frames with a stamp. May be NULL.
+ * @param user User data passed to on_sent.
+ * @return true The thread is running.
+ */
+bool sender_start(sender_t* sender, transport_t* transport, pacing_t* pacing, sender_sent_t on_sent, void* user);
+
+/**
+ * @brief Returns the slot to render the next frame into. Its stamp must be set as well.
+ *
+ * @param sender The sender.
+ * @return mailbox_slot_t* The slot.
+ */
+mailbox_slot_t* sender_frame(sender_t* sender);
+
+/**
+ * @brief Hands the frame rendered into sender_frame to the sending thread.
+ *
+ * @param sender The sender.
+ * @return true The previous frame was not sent yet and is dropped. sender_frame now returns its slot.
+ */
+bool sender_submit(sender_t* sender);
+
+/**
+ * @brief Returns the error of the sending thread.
+ *
+ * @param sender The sender.
+ * @return int LIBUSB_SUCCESS or the libusb error that stopped the sending thread.
+ */
+int sender_error(sender_t* sender);
+
+/**
+ * @brief Sends the last submitted frame and stops the sending thread.
+ *
+ * @param sender The sender.
+ * @return int LIBUSB_SUCCESS or the libusb error that stopped the sending thread.
+ */
+int sender_stop(sender_t* sender);
@@ -0,0 +1,237 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "string.h"
+#include "assert.h"
+
+#include "transfer.h"
+
+/**
+ * @brief Maps the status of a completed transfer to a libusb error code.
+ *
+ * @param transfer The completed transfer.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+static int transfer_result(struct libusb_transfer* transfer)
+{
+    switch (transfer->status)
+    {
+    case LIBUSB_TRANSFER_COMPLETED:
+        return LIBUSB_SUCCESS;
+
+    case LIBUSB_TRANSFER_TIMED_OUT:
+        return LIBUSB_ERROR_TIMEOUT;
+
+    case LIBUSB_TRANSFER_STALL:
+        return LIBUSB_ERROR_PIPE;
+
+    case LIBUSB_TRANSFER_NO_DEVICE:
+        return LIBUSB_ERROR_NO_DEVICE;
+
+    case LIBUSB_TRANSFER_OVERFLOW:
+        return LIBUSB_ERROR_OVERFLOW;
+
+    case LIBUSB_TRANSFER_CANCELLED:
+        return LIBUSB_ERROR_INTERRUPTED;
+
+    default:
+        return LIBUSB_ERROR_IO;
+    }
+}
+
+static void LIBUSB_CALL on_transfer_complete(struct libusb_transfer* transfer)
+{
+    transfer_queue_t* queue = transfer->user_data;
+
+    int result = transfer_result(transfer);
+    if (result < LIBUSB_SUCCESS)
+    {
+        int expected = LIBUSB_SUCCESS;
+        atomic_compare_exchange_strong(&queue->error, &expected, result);
+    }
+
+    for (int i = 0; i < TRANSFER_QUEUE_DEPTH; i++)
+    {
+        if (queue->transfers[i] == transfer)
+        {
+            atomic_store(&queue->busy[i], false);
+            break;
+        }
+    }
+
+    queue->completed = 1;
+
+    // Last access, the waiting thread may free the queue as soon as nothing is in flight.
+    atomic_fetch_sub(&queue->in_flight, 1);
+}
+
+/**
+ * @brief Handles libusb events until fewer than the given number of transfers are in flight. Waits for the completions
+ * of this queue only, another thread handling the events may complete them.
+ *
+ * @param queue The queue.
+ * @param max Maximum number of transfers that may stay in flight.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+static int wait_in_flight(transfer_queue_t* queue, int max)
+{
+    while (atomic_load(&queue->in_flight) > max)
+    {
+        queue->completed = 0;
+
+        // A completion between the check and the reset would otherwise be missed
+        if (atomic_load(&queue->in_flight) <= max)
+        {
+            break;
+        }
+
+        int ret = libusb_handle_events_completed(NULL, &queue->completed);
+
+        if (ret < LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED)
+        {
+            return ret;
+        }
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+int transfer_queue_init(transfer_queue_t* queue, struct libusb_device_handle* handle)
+{
+    assert(queue != NULL);
+
+    memset(queue, 0, sizeof(transfer_queue_t));
+    queue->handle = handle;
+    atomic_init(&queue->in_flight, 0);
+    atomic_init(&queue->error, LIBUSB_SUCCESS);
+
+    for (int i = 0; i < TRANSFER_QUEUE_DEPTH; i++)
+    {
+        atomic_init(&queue->busy[i], false);
+    }
+
+    for (int i = 0; i < TRANSFER_QUEUE_DEPTH; i++)
+    {
+        queue->transfers[i] = libusb_alloc_transfer(0);
+
+        if (queue->transfers[i] == NULL)
+        {
+            transfer_queue_free(queue);
+            return LIBUSB_ERROR_NO_MEM;
+        }
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+int transfer_queue_submit(transfer_queue_t* queue, const uint8_t* data)
+{
+    assert(queue != NULL);
+    assert(data != NULL);
+
+    int ret = wait_in_flight(queue, TRANSFER_QUEUE_DEPTH - 1);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        return ret;
+    }
+
+    int slot = 0;
+    while (atomic_load(&queue->busy[slot]))
+    {
+        slot++;
+    }
+
+    uint8_t* buffer = queue->buffers[slot];
+    libusb_fill_control_setup(buffer, 0x21, 0x09, 0x0204, 0x0001, TRANSFER_REPORT_LEN);
+    memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, data, TRANSFER_REPORT_LEN);
+
+    struct libusb_transfer* transfer = queue->transfers[slot];
+    libusb_fill_control_transfer(transfer, queue->handle, buffer, on_transfer_complete, queue, queue->timeout_ms);
+
+    // Marked before submitting, the transfer may complete on another thread before libusb_submit_transfer returns
+    atomic_store(&queue->busy[slot], true);
+    atomic_fetch_add(&queue->in_flight, 1);
+
+    ret = libusb_submit_transfer(transfer);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        atomic_store(&queue->busy[slot], false);
+        atomic_fetch_sub(&queue->in_flight, 1);
+        return ret;
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+int transfer_queue_flush(transfer_queue_t* queue)
+{
+    assert(queue != NULL);
+
+    int ret = wait_in_flight(queue, 0);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        return ret;
+    }
+
+    return atomic_exchange(&queue->error, LIBUSB_SUCCESS);
+}
+
+bool transfer_queue_free(transfer_queue_t* queue)
+{
+    if (queue == NULL)
+    {
+        return true;
+    }
+
+    if (wait_in_flight(queue, 0) < LIBUSB_SUCCESS)
+    {
+        for (int i = 0; i < TRANSFER_QUEUE_DEPTH; i++)
+        {
+            if (atomic_load(&queue->busy[i]))
+            {
+                libusb_cancel_transfer(queue->transfers[i]);
+            }
+        }
+
+        // Transfers still submitted must not be freed, they are leaked instead.
+        if (wait_in_flight(queue, 0) < LIBUSB_SUCCESS)
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < TRANSFER_QUEUE_DEPTH; i++)
+    {
+        if (queue->transfers[i] != NULL)
+        {
+            libusb_free_transfer(queue->transfers[i]);
+            queue->transfers[i] = NULL;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,114 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stdatomic.h"
+
+#include "libusb-1.0/libusb.h"
+
+/**
+ * @brief Maximum number of reports that are in flight at the same time.
+ */
+#define TRANSFER_QUEUE_DEPTH 4
+
+/**
+ * @brief Size of a single report.
+ */
+#define TRANSFER_REPORT_LEN 64
+
+/**
+ * @brief Queue of asynchronous SET_REPORT control transfers.
+ *
+ * Reports are submitted without waiting for the previous report to complete, so building and
+ * submitting the next report overlaps with the USB round trip of the current one.
+ */
+typedef struct
+{
+    struct libusb_device_handle* handle;
+
+    struct libusb_transfer* transfers[TRANSFER_QUEUE_DEPTH];
+    uint8_t buffers[TRANSFER_QUEUE_DEPTH][LIBUSB_CONTROL_SETUP_SIZE + TRANSFER_REPORT_LEN];
+    atomic_bool busy[TRANSFER_QUEUE_DEPTH];
+
+    /**
+     * @brief Transfers of the queue not completed yet. Completions may run on any thread handling libusb events, i.e.
+     * another worker with --all, so the state they change is atomic.
+     */
+    atomic_int in_flight;
+
+    /**
+     * @brief First error reported by a completed transfer or LIBUSB_SUCCESS.
+     */
+    atomic_int error;
+
+    /**
+     * @brief Set by every completion of the queue, ends libusb_handle_events_completed of the waiting thread.
+     */
+    int completed;
+
+    /**
+     * @brief Timeout of submitted transfers in milliseconds, 0 waits forever.
+     */
+    unsigned int timeout_ms;
+
+} transfer_queue_t;
+
+/**
+ * @brief Allocates the transfers of the queue.
+ *
+ * @param queue The queue.
+ * @param handle USB device handle.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+int transfer_queue_init(transfer_queue_t* queue, struct libusb_device_handle* handle);
+
+/**
+ * @brief Submits a report. If all transfers are in flight this waits until one completes.
+ *
+ * @param queue The queue.
+ * @param data The report. Must be TRANSFER_REPORT_LEN bytes long.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+int transfer_queue_submit(transfer_queue_t* queue, const uint8_t* data);
+
+/**
+ * @brief Waits until all submitted reports completed.
+ *
+ * @param queue The queue.
+ * @return int LIBUSB_SUCCESS or the first error of any transfer since the last flush.
+ */
+int transfer_queue_flush(transfer_queue_t* queue);
+
+/**
+ * @brief Waits for pending reports and frees the transfers of the queue. Transfers that cannot be cancelled are left
+ * allocated, the queue must be kept then since their completions still refer to it.
+ *
+ * @param queue The queue.
+ * @return true The transfers were freed.
+ * @return false Transfers are still in flight.
+ */
+bool transfer_queue_free(transfer_queue_t* queue);
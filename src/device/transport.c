@@ -0,0 +1,260 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "stdlib.h"
+#include "string.h"
+#include "assert.h"
+
+#include "transport.h"
+#include "transfer.h"
+#include "pacing.h"
+#include "device.h"
+#include "../stats/stats.h"
+
+static int libusb_send(transport_t* transport, const uint8_t* report)
+{
+    int written = libusb_control_transfer(transport->handle, 0x21, 0x09, 0x0204, 0x0001, (uint8_t*)report, TRANSPORT_REPORT_LEN, transport->timeout_ms);
+
+    return written < LIBUSB_SUCCESS ? written : LIBUSB_SUCCESS;
+}
+
+/**
+ * @brief Pipelines the reports using asynchronous transfers.
+ */
+static int libusb_send_many(transport_t* transport, const uint8_t* reports, int count)
+{
+    int ret = LIBUSB_SUCCESS;
+
+    if (transport->queue == NULL)
+    {
+        for (int i = 0; i < count && ret == LIBUSB_SUCCESS; i++)
+        {
+            ret = libusb_send(transport, reports + i * TRANSPORT_REPORT_LEN);
+        }
+
+        return ret;
+    }
+
+    transport->queue->timeout_ms = transport->timeout_ms;
+
+    for (int i = 0; i < count && ret == LIBUSB_SUCCESS; i++)
+    {
+        ret = transfer_queue_submit(transport->queue, reports + i * TRANSPORT_REPORT_LEN);
+    }
+
+    int flushed = transfer_queue_flush(transport->queue);
+
+    return ret < LIBUSB_SUCCESS ? ret : flushed;
+}
+
+static void libusb_close_transport(transport_t* transport)
+{
+    // The transfers are bound to the handle, so they are released first.
+    if (transport->queue != NULL)
+    {
+        if (transfer_queue_free(transport->queue))
+        {
+            free(transport->queue);
+        }
+
+        transport->queue = NULL;
+    }
+
+    device_close(transport->handle);
+    transport->handle = NULL;
+}
+
+static const transport_ops_t LIBUSB_OPS = {
+    .send = libusb_send,
+    .send_many = libusb_send_many,
+    .close = libusb_close_transport,
+};
+
+void transport_libusb_init(transport_t* transport, struct libusb_device_handle* handle)
+{
+    assert(transport != NULL);
+    assert(handle != NULL);
+
+    memset(transport, 0, sizeof(transport_t));
+
+    transport->ops = &LIBUSB_OPS;
+    transport->type = TRANSPORT_LIBUSB;
+    transport->handle = handle;
+    transport->fd = -1;
+
+    transport->queue = malloc(sizeof(transfer_queue_t));
+
+    if (transport->queue != NULL && transfer_queue_init(transport->queue, handle) < LIBUSB_SUCCESS)
+    {
+        free(transport->queue);
+        transport->queue = NULL;
+    }
+
+    struct libusb_device_descriptor dev_dsc = { 0 };
+    libusb_get_device_descriptor(libusb_get_device(handle), &dev_dsc);
+
+    transport->vendor_id = dev_dsc.idVendor;
+    transport->product_id = dev_dsc.idProduct;
+
+    transport->bus = libusb_get_bus_number(libusb_get_device(handle));
+    transport->port_count = libusb_get_port_numbers(libusb_get_device(handle), transport->ports, sizeof(transport->ports));
+}
+
+/**
+ * @brief Writes the reports to the recording of the transport.
+ *
+ * @param transport The transport.
+ * @param reports The reports.
+ * @param count Number of reports.
+ */
+static void record(transport_t* transport, const uint8_t* reports, int count)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long long us = (now.tv_sec - transport->record_start.tv_sec) * 1000000LL + (now.tv_nsec - transport->record_start.tv_nsec) / 1000;
+
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(transport->record, "%lld ", us);
+
+        for (int j = 0; j < TRANSPORT_REPORT_LEN; j++)
+        {
+            fprintf(transport->record, "%02x", reports[i * TRANSPORT_REPORT_LEN + j]);
+        }
+
+        fputc('\n', transport->record);
+    }
+}
+
+bool transport_record(transport_t* transport, const char* path)
+{
+    assert(transport != NULL);
+
+    transport->record = fopen(path, "w");
+
+    if (transport->record == NULL)
+    {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &transport->record_start);
+    return true;
+}
+
+int transport_send(transport_t* transport, const uint8_t* report)
+{
+    assert(transport != NULL);
+
+    if (transport->lost)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    if (transport->record != NULL)
+    {
+        record(transport, report, 1);
+    }
+
+    uint64_t start = stats_now();
+    transport->issued = transport->issued != 0 ? transport->issued : start;
+
+    int ret = transport->ops->send(transport, report);
+
+    stats_phase_end(STATS_PHASE_TRANSFER, start);
+    stats_transfer(1, TRANSPORT_REPORT_LEN, ret >= LIBUSB_SUCCESS);
+
+    if (transport->pacing != NULL && ret >= LIBUSB_SUCCESS)
+    {
+        pacing_observe(transport->pacing, 1, stats_now() - start);
+    }
+
+    return ret;
+}
+
+int transport_send_many(transport_t* transport, const uint8_t* reports, int count)
+{
+    assert(transport != NULL);
+
+    if (transport->lost)
+    {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    if (transport->record != NULL)
+    {
+        record(transport, reports, count);
+    }
+
+    uint64_t start = stats_now();
+    transport->issued = transport->issued != 0 ? transport->issued : start;
+
+    int ret = LIBUSB_SUCCESS;
+    int sent = 0;
+
+    if (count == 1 || transport->ops->send_many == NULL)
+    {
+        for (; sent < count && ret == LIBUSB_SUCCESS; sent++)
+        {
+            ret = transport->ops->send(transport, reports + sent * TRANSPORT_REPORT_LEN);
+        }
+    }
+    else
+    {
+        ret = transport->ops->send_many(transport, reports, count);
+        sent = count;
+    }
+
+    stats_phase_end(STATS_PHASE_TRANSFER, start);
+    stats_transfer(sent, sent * TRANSPORT_REPORT_LEN, ret >= LIBUSB_SUCCESS);
+
+    // Reports sent with send_many overlap, so the time per report is the throughput rather than the round trip.
+    if (transport->pacing != NULL && ret >= LIBUSB_SUCCESS)
+    {
+        pacing_observe(transport->pacing, sent, stats_now() - start);
+    }
+
+    return ret;
+}
+
+void transport_close(transport_t* transport)
+{
+    if (transport == NULL || transport->ops == NULL)
+    {
+        return;
+    }
+
+    uint64_t start = stats_now();
+
+    transport->ops->close(transport);
+    transport->ops = NULL;
+
+    stats_phase_end(STATS_PHASE_CLEANUP, start);
+
+    if (transport->record != NULL)
+    {
+        fclose(transport->record);
+        transport->record = NULL;
+    }
+}
@@ -0,0 +1,307 @@
+/*
+MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stdio.h"
+#include "time.h"
+
+#include "libusb-1.0/libusb.h"
+
+#include "lighting.h"
+#include "transfer.h"
+
+/**
+ * @brief Size of a single report.
+ */
+#define TRANSPORT_REPORT_LEN 64
+
+/**
+ * @brief Defines how reports are sent to the device.
+ */
+typedef enum
+{
+    /**
+     * @brief SET_REPORT control transfers via libusb. Detaches the kernel driver while the device is open.
+     */
+    TRANSPORT_LIBUSB = 0,
+
+    /**
+     * @brief Output reports via /dev/hidrawN. The kernel driver stays bound, so typing is not interrupted.
+     */
+    TRANSPORT_HIDRAW = 1,
+
+    /**
+     * @brief In-process mock device for running without hardware.
+     */
+    TRANSPORT_MOCK = 2,
+
+} TRANSPORT_TYPE;
+
+/**
+ * @brief Behaviour of the mock device.
+ */
+typedef struct
+{
+    /**
+     * @brief Simulated duration of every transfer in microseconds.
+     */
+    unsigned int latency_us;
+
+    /**
+     * @brief Every n-th transfer fails with error. 0 disables errors.
+     */
+    unsigned int fail_every;
+
+    /**
+     * @brief Error code returned by failing transfers.
+     */
+    int error;
+
+    /**
+     * @brief Suppresses the summary logged when the device is closed.
+     */
+    bool quiet;
+
+} mock_config_t;
+
+struct mock_device;
+struct pacing;
+
+typedef struct transport transport_t;
+
+/**
+ * @brief Functions implementing a transport.
+ */
+typedef struct
+{
+    /**
+     * @brief Sends a single report.
+     *
+     * @return int LIBUSB_SUCCESS or a libusb error code.
+     */
+    int (*send)(transport_t* transport, const uint8_t* report);
+
+    /**
+     * @brief Sends count consecutive reports. May be NULL if the transport has no faster way than sending them one by one.
+     *
+     * @return int LIBUSB_SUCCESS or a libusb error code.
+     */
+    int (*send_many)(transport_t* transport, const uint8_t* reports, int count);
+
+    /**
+     * @brief Releases the device.
+     */
+    void (*close)(transport_t* transport);
+
+} transport_ops_t;
+
+/**
+ * @brief An opened device that reports can be sent to.
+ */
+struct transport
+{
+    const transport_ops_t* ops;
+
+    TRANSPORT_TYPE type;
+
+    uint16_t vendor_id;
+    uint16_t product_id;
+
+    /**
+     * @brief Device handle of the libusb transport.
+     */
+    struct libusb_device_handle* handle;
+
+    /**
+     * @brief Asynchronous transfers of the libusb transport, allocated once when it is opened. NULL if allocating
+     * them failed, the reports are sent one by one then.
+     */
+    transfer_queue_t* queue;
+
+    /**
+     * @brief Bus and port path of the libusb transport. The device is looked for at the same port when it is opened
+     * again, see device_recover.
+     */
+    uint8_t bus;
+    uint8_t ports[8];
+    int port_count;
+
+    /**
+     * @brief File descriptor of the hidraw transport.
+     */
+    int fd;
+
+    /**
+     * @brief Index among the matching hidraw nodes, see transport_hidraw_open.
+     */
+    int index;
+
+    /**
+     * @brief State of the mock transport.
+     */
+    struct mock_device* mock;
+
+    /**
+     * @brief If set every sent report is written to this file, see transport_record.
+     */
+    FILE* record;
+    struct timespec record_start;
+
+    /**
+     * @brief Color correction applied to all colors sent to the device. NULL sends the colors unchanged.
+     */
+    const struct correction* correction;
+
+    /**
+     * @brief If set the completion time of every report is passed to this controller, see pacing_observe.
+     */
+    struct pacing* pacing;
+
+    /**
+     * @brief Monotonic time in nanoseconds the first report was issued after it was reset to 0, see sender.
+     */
+    uint64_t issued;
+
+    /**
+     * @brief Lighting last applied by device_apply_lighting. Applied again after the device was opened again.
+     */
+    lighting_t lighting;
+    bool has_lighting;
+
+    /**
+     * @brief The device was lost and could not be opened again. Sending fails with LIBUSB_ERROR_NO_DEVICE until
+     * device_recover succeeds.
+     */
+    bool lost;
+
+    /**
+     * @brief Set by callers on an event loop. Errors of a lost device are returned instead of waiting for it, the
+     * caller recovers it with device_recover_start and device_recover_step.
+     */
+    bool defer_recovery;
+
+    /**
+     * @brief Timeout of every libusb transfer in milliseconds, 0 waits forever. Set by callers that must not block on a
+     * stalled device, a timed out transfer counts as lost device then.
+     */
+    unsigned int timeout_ms;
+};
+
+/**
+ * @brief Initializes a libusb transport for the given handle. All interfaces must already be claimed.
+ *
+ * @param transport The transport.
+ * @param handle USB device handle. Released and closed when the transport is closed.
+ */
+void transport_libusb_init(transport_t* transport, struct libusb_device_handle* handle);
+
+/**
+ * @brief Opens the hidraw node of a device with the given ids.
+ *
+ * @param transport The transport.
+ * @param vendor_id Vendor id.
+ * @param product_id Product id.
+ * @param index Selects the n-th matching device if several are connected.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_NOT_FOUND if no node exists or LIBUSB_ERROR_ACCESS.
+ */
+int transport_hidraw_open(transport_t* transport, uint16_t vendor_id, uint16_t product_id, int index);
+
+/**
+ * @brief Opens the hidraw node of the USB device at the given bus and address, i.e. one that just arrived.
+ *
+ * @param transport The transport.
+ * @param vendor_id Vendor id.
+ * @param product_id Product id.
+ * @param bus Bus number of the USB device.
+ * @param address Address of the USB device on the bus.
+ * @return int LIBUSB_SUCCESS, LIBUSB_ERROR_NOT_FOUND if no node exists or LIBUSB_ERROR_ACCESS.
+ */
+int transport_hidraw_open_device(
+    transport_t* transport, uint16_t vendor_id, uint16_t product_id, uint8_t bus, uint8_t address);
+
+/**
+ * @brief Opens an in-process mock device that keeps every transfer with its timestamp.
+ *
+ * @param transport The transport.
+ * @param config Behaviour of the mock device.
+ * @return int LIBUSB_SUCCESS or LIBUSB_ERROR_NO_MEM.
+ */
+int transport_mock_open(transport_t* transport, const mock_config_t* config);
+
+/**
+ * @brief Returns the number of transfers the mock device received so far.
+ *
+ * @param transport The mock transport.
+ * @return size_t Number of transfers, 0 for other transports.
+ */
+size_t transport_mock_count(const transport_t* transport);
+
+/**
+ * @brief Copies a report received by the mock device.
+ *
+ * @param transport The mock transport.
+ * @param index Index of the transfer, see transport_mock_count.
+ * @param report Receives the report. Must be TRANSPORT_REPORT_LEN bytes long.
+ * @return true The transfer exists.
+ */
+bool transport_mock_report(const transport_t* transport, size_t index, uint8_t* report);
+
+/**
+ * @brief Starts recording all reports sent through the transport. Each report is written as one line
+ * holding the microseconds since the recording started and the report in hex.
+ *
+ * @param transport The transport.
+ * @param path Path of the recording.
+ * @return bool True if the file could be opened.
+ */
+bool transport_record(transport_t* transport, const char* path);
+
+/**
+ * @brief Sends a single report.
+ *
+ * @param transport The transport.
+ * @param report The report. Must be TRANSPORT_REPORT_LEN bytes long.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+int transport_send(transport_t* transport, const uint8_t* report);
+
+/**
+ * @brief Sends count consecutive reports.
+ *
+ * @param transport The transport.
+ * @param reports The reports. Must be count * TRANSPORT_REPORT_LEN bytes long.
+ * @param count Number of reports.
+ * @return int LIBUSB_SUCCESS or the first libusb error code.
+ */
+int transport_send_many(transport_t* transport, const uint8_t* reports, int count);
+
+/**
+ * @brief Closes the transport.
+ *
+ * @param transport The transport.
+ */
+void transport_close(transport_t* transport);
@@ -0,0 +1,594 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "limits.h"
+#include "signal.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "sys/timerfd.h"
+
+#include "animation.h"
+#include "fade.h"
+#include "../device/device.h"
+#include "../device/sender.h"
+#include "../log/log.h"
+
+#define ANIMATION_KEYFRAME_LEN ((FRAME_KEYS * 3 + 3) & ~3) // Colors of a keyframe padded to 4 bytes
+#define ANIMATION_DELTA_ENTRY_LEN 4
+
+_Static_assert(sizeof(animation_header_t) == 64, "animation header must be 64 bytes");
+_Static_assert(sizeof(animation_record_t) == 4, "animation record header must be 4 bytes");
+
+/**
+ * @brief Writes frame records and keeps the previous frame to compute the deltas.
+ */
+typedef struct
+{
+    FILE* file;
+
+    frame_t previous;
+
+    uint32_t frames;
+    uint32_t keyframe_interval;
+
+    bool ok;
+
+} encoder_t;
+
+/**
+ * @brief Reads frame records from the mapped file.
+ */
+typedef struct
+{
+    const uint8_t* data;
+    size_t size;
+
+    /**
+     * @brief Offset of the next record.
+     */
+    size_t offset;
+
+    /**
+     * @brief Everything before this offset was released with MADV_DONTNEED.
+     */
+    size_t released;
+
+} player_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    running = 0;
+}
+
+/**
+ * @brief Appends a frame, as keyframe if due, otherwise as delta to the previous frame.
+ *
+ * @param encoder The encoder.
+ * @param frame The frame.
+ */
+static void encode_frame(encoder_t* encoder, const frame_t* frame)
+{
+    animation_record_t record = { 0 };
+
+    if (encoder->frames % encoder->keyframe_interval == 0)
+    {
+        uint8_t colors[ANIMATION_KEYFRAME_LEN] = { 0 };
+
+        for (int i = 0; i < FRAME_KEYS; i++)
+        {
+            colors[i * 3] = frame->keys[i].red;
+            colors[i * 3 + 1] = frame->keys[i].green;
+            colors[i * 3 + 2] = frame->keys[i].blue;
+        }
+
+        record.type = ANIMATION_KEYFRAME;
+        record.count = FRAME_KEYS;
+
+        encoder->ok = encoder->ok && fwrite(&record, sizeof(record), 1, encoder->file) == 1
+            && fwrite(colors, sizeof(colors), 1, encoder->file) == 1;
+    }
+    else
+    {
+        uint8_t entries[FRAME_KEYS * ANIMATION_DELTA_ENTRY_LEN];
+
+        for (int i = 0; i < FRAME_KEYS; i++)
+        {
+            const rgb_t* key = &frame->keys[i];
+            const rgb_t* prev = &encoder->previous.keys[i];
+
+            if (key->red != prev->red || key->green != prev->green || key->blue != prev->blue)
+            {
+                uint8_t* entry = &entries[record.count++ * ANIMATION_DELTA_ENTRY_LEN];
+                entry[0] = i;
+                entry[1] = key->red;
+                entry[2] = key->green;
+                entry[3] = key->blue;
+            }
+        }
+
+        record.type = ANIMATION_DELTA;
+
+        encoder->ok = encoder->ok && fwrite(&record, sizeof(record), 1, encoder->file) == 1
+            && (record.count == 0 || fwrite(entries, record.count * ANIMATION_DELTA_ENTRY_LEN, 1, encoder->file) == 1);
+    }
+
+    encoder->previous = *frame;
+    encoder->frames++;
+}
+
+/**
+ * @brief Encodes the lines of the source, see animation_encode_run.
+ *
+ * @param source The source.
+ * @param encoder The encoder.
+ * @return int Number of invalid lines.
+ */
+static int encode_source(FILE* source, encoder_t* encoder)
+{
+    frame_t frame;
+    frame_init(&frame);
+
+    bool pending = false;
+
+    char* line = NULL;
+    size_t len = 0;
+    int lineno = 0;
+    int failed = 0;
+
+    while (getline(&line, &len, source) != -1)
+    {
+        lineno++;
+
+        char* save = NULL;
+        char* command = strtok_r(line, " \t\r\n", &save);
+
+        if (command == NULL || command[0] == '#')
+        {
+            continue;
+        }
+
+        char* rest = strtok_r(NULL, "\r\n", &save);
+
+        if (strcmp(command, "frame") == 0)
+        {
+            if (pending)
+            {
+                encode_frame(encoder, &frame);
+            }
+
+            char* color = rest != NULL ? strtok_r(rest, " \t", &save) : NULL;
+
+            if (color != NULL)
+            {
+                char* end;
+                long value = strtol(color[0] == '#' ? color + 1 : color, &end, 16);
+
+                if (*end != '\0' || value < 0 || value > 0xffffff)
+                {
+                    log_error("Invalid color in line %i: %s", lineno, color);
+                    failed++;
+                    continue;
+                }
+
+                rgb_t fill = { (value >> 16) & 0xff, (value >> 8) & 0xff, value & 0xff };
+                frame_fill(&frame, fill);
+            }
+
+            pending = true;
+        }
+        else if (strcmp(command, "key") == 0 && pending)
+        {
+            if (rest == NULL || !frame_parse_keys(rest, &frame))
+            {
+                log_error("Invalid keys in line %i", lineno);
+                failed++;
+            }
+        }
+        else if (strcmp(command, "repeat") == 0 && pending)
+        {
+            char* end;
+            long count = rest != NULL ? strtol(rest, &end, 10) : -1;
+
+            if (count < 0)
+            {
+                log_error("Invalid repeat count in line %i", lineno);
+                failed++;
+                continue;
+            }
+
+            for (long i = 0; i <= count; i++)
+            {
+                encode_frame(encoder, &frame);
+            }
+
+            pending = false;
+        }
+        else if (strcmp(command, "key") == 0 || strcmp(command, "repeat") == 0)
+        {
+            log_error("Line %i: %s needs a preceding frame", lineno, command);
+            failed++;
+        }
+        else
+        {
+            log_error("Invalid command in line %i: %s", lineno, command);
+            failed++;
+        }
+    }
+
+    if (pending)
+    {
+        encode_frame(encoder, &frame);
+    }
+
+    free(line);
+
+    return failed;
+}
+
+int animation_encode_run(args_t* args)
+{
+    FILE* source = fopen(args->encode_path, "r");
+
+    if (source == NULL)
+    {
+        log_error("Error opening %s - %s - Abort.\n", args->encode_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Without --output the animation is stored next to the source.
+    char path[PATH_MAX];
+
+    if (args->output_path != NULL)
+    {
+        snprintf(path, sizeof(path), "%s", args->output_path);
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "%s", args->encode_path);
+
+        char* dot = strrchr(path, '.');
+        char* slash = strrchr(path, '/');
+
+        if (dot != NULL && (slash == NULL || dot > slash + 1))
+        {
+            *dot = '\0';
+        }
+
+        strncat(path, ANIMATION_EXTENSION, sizeof(path) - strlen(path) - 1);
+    }
+
+    char tmp[PATH_MAX + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    encoder_t encoder;
+    memset(&encoder, 0, sizeof(encoder));
+    frame_init(&encoder.previous);
+
+    unsigned int fps = args->fps > 0 ? args->fps : FADE_DEFAULT_FPS;
+    fps = fps > FADE_MAX_FPS ? FADE_MAX_FPS : fps;
+
+    // One keyframe per second.
+    encoder.keyframe_interval = fps;
+    encoder.file = fopen(tmp, "wb");
+    encoder.ok = encoder.file != NULL;
+
+    if (!encoder.ok)
+    {
+        log_error("Error creating %s - %s - Abort.\n", tmp, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    animation_header_t header;
+    memset(&header, 0, sizeof(header));
+    encoder.ok = fwrite(&header, sizeof(header), 1, encoder.file) == 1;
+
+    int failed = encode_source(source, &encoder);
+    fclose(source);
+
+    // The number of frames is only known at the end.
+    memcpy(header.magic, ANIMATION_MAGIC, sizeof(header.magic));
+    header.version = ANIMATION_VERSION;
+    header.fps = fps;
+    header.frames = encoder.frames;
+    header.keyframe_interval = encoder.keyframe_interval;
+
+    encoder.ok = encoder.ok && fseek(encoder.file, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, encoder.file) == 1;
+
+    encoder.ok = encoder.ok && fseek(encoder.file, 0, SEEK_END) == 0;
+    long size = ftell(encoder.file);
+
+    if (fclose(encoder.file) != 0 || !encoder.ok || failed > 0 || header.frames == 0 || rename(tmp, path) != 0)
+    {
+        remove(tmp);
+        log_error("%s not written, %i invalid lines, %u frames - Abort.\n", path, failed, header.frames);
+        return EXIT_FAILURE;
+    }
+
+    if (args->verbose)
+    {
+        log_info("Encoded %u frames at %u fps to %s (%ld bytes)", header.frames, fps, path, size);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Applies the next frame record to the frame.
+ *
+ * @param player The player.
+ * @param frame The frame, holds the previous frame.
+ * @return true The record was valid.
+ */
+static bool decode_frame(player_t* player, frame_t* frame)
+{
+    if (player->size - player->offset < sizeof(animation_record_t))
+    {
+        return false;
+    }
+
+    animation_record_t record;
+    memcpy(&record, player->data + player->offset, sizeof(record));
+
+    const uint8_t* payload = player->data + player->offset + sizeof(record);
+    size_t available = player->size - player->offset - sizeof(record);
+
+    if (record.type == ANIMATION_KEYFRAME)
+    {
+        if (record.count != FRAME_KEYS || available < ANIMATION_KEYFRAME_LEN)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < FRAME_KEYS; i++)
+        {
+            frame->keys[i].red = payload[i * 3];
+            frame->keys[i].green = payload[i * 3 + 1];
+            frame->keys[i].blue = payload[i * 3 + 2];
+        }
+
+        // Everything before a keyframe is not needed anymore. Dropping it keeps the resident size flat.
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t played = player->offset & ~(page - 1);
+
+        player->offset += sizeof(record) + ANIMATION_KEYFRAME_LEN;
+
+        if (played > player->released)
+        {
+            madvise((void*)(player->data + player->released), played - player->released, MADV_DONTNEED);
+            player->released = played;
+        }
+
+        return true;
+    }
+
+    if (record.type != ANIMATION_DELTA || available < (size_t)record.count * ANIMATION_DELTA_ENTRY_LEN)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < record.count; i++)
+    {
+        const uint8_t* entry = payload + i * ANIMATION_DELTA_ENTRY_LEN;
+        rgb_t color = { entry[1], entry[2], entry[3] };
+
+        frame_set_key(frame, entry[0], color);
+    }
+
+    player->offset += sizeof(record) + (size_t)record.count * ANIMATION_DELTA_ENTRY_LEN;
+
+    return true;
+}
+
+int animation_play_run(args_t* args)
+{
+    int fd = open(args->animation_path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        log_error("Error opening %s - %s - Abort.\n", args->animation_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(animation_header_t))
+    {
+        log_error("%s is not an animation - Abort.\n", args->animation_path);
+        exit(EXIT_FAILURE);
+    }
+
+    player_t player = { 0 };
+    player.size = st.st_size;
+    player.data = mmap(NULL, player.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (player.data == MAP_FAILED)
+    {
+        log_error("Error mapping %s - %s - Abort.\n", args->animation_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Frames are read front to back, so aggressive readahead pays off and read pages can be dropped early.
+    madvise((void*)player.data, player.size, MADV_SEQUENTIAL);
+
+    animation_header_t header;
+    memcpy(&header, player.data, sizeof(header));
+    player.offset = sizeof(header);
+
+    if (memcmp(header.magic, ANIMATION_MAGIC, sizeof(header.magic)) != 0 || header.version != ANIMATION_VERSION
+        || header.fps == 0 || header.fps > FADE_MAX_FPS || header.frames == 0)
+    {
+        log_error("%s is not an animation of version %i - Abort.\n", args->animation_path, ANIMATION_VERSION);
+        exit(EXIT_FAILURE);
+    }
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    lighting_t lighting;
+    args_to_lighting(args, &lighting);
+    lighting.mode = CUSTOM;
+    lighting.red = lighting.green = lighting.blue = 0;
+
+    if (device_apply_lighting(lighting, &transport) < LIBUSB_SUCCESS)
+    {
+        munmap((void*)player.data, player.size);
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    frame_t frame;
+    frame_init(&frame);
+
+    // The animation keeps its frame rate, pacing only limits the reports per upload.
+    pacing_t pacing;
+    pacing_init(&pacing, args->target_latency_us, header.fps, args->verbose);
+
+    sender_t sender;
+
+    if (!sender_start(&sender, &transport, args->target_latency_us > 0 ? &pacing : NULL, NULL, NULL))
+    {
+        log_error("Error starting the sending thread - Abort.\n");
+        munmap((void*)player.data, player.size);
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    // At 1 fps the period is a whole second, which timerfd does not accept as nanoseconds.
+    struct timespec period = { 1 / header.fps, 1000000000L / header.fps % 1000000000L };
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct itimerspec its = { .it_interval = period, .it_value = start };
+    its.it_value.tv_sec += period.tv_sec;
+    its.it_value.tv_nsec += period.tv_nsec;
+
+    if (its.it_value.tv_nsec >= 1000000000L)
+    {
+        its.it_value.tv_nsec -= 1000000000L;
+        its.it_value.tv_sec++;
+    }
+
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+    if (timer < 0 || timerfd_settime(timer, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+    {
+        log_error("Error starting the frame timer - %s - Abort.\n", strerror(errno));
+
+        if (timer >= 0)
+        {
+            close(timer);
+        }
+
+        sender_stop(&sender);
+        munmap((void*)player.data, player.size);
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t played = 0;
+    uint32_t late = 0;
+    int ret = LIBUSB_SUCCESS;
+    uint64_t due = 1;
+
+    while (running && played < header.frames)
+    {
+        // Frames that are overdue are decoded, since the deltas build on them, but only the latest one is sent.
+        uint32_t decoded = 0;
+
+        for (; decoded < due && played < header.frames; decoded++, played++)
+        {
+            if (!decode_frame(&player, &frame))
+            {
+                log_error("%s is damaged at frame %u.", args->animation_path, played);
+                ret = LIBUSB_ERROR_IO;
+                break;
+            }
+        }
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            break;
+        }
+
+        late += decoded - 1;
+
+        // The decoder keeps its own frame, the deltas of the next record apply to it.
+        sender_frame(&sender)->frame = frame;
+        sender_frame(&sender)->stamp = 0;
+        sender_submit(&sender);
+
+        ret = sender_error(&sender);
+
+        if (ret < LIBUSB_SUCCESS)
+        {
+            break;
+        }
+
+        if (played == header.frames)
+        {
+            break;
+        }
+
+        // Blocks until the next frame is due. Counts more than one expiration if sending took longer than a frame.
+        due = 0;
+        while (running && due == 0 && ret >= LIBUSB_SUCCESS)
+        {
+            if (read(timer, &due, sizeof(due)) < 0 && errno != EINTR)
+            {
+                log_error("Error waiting for the next frame - %s", strerror(errno));
+                ret = LIBUSB_ERROR_OTHER;
+            }
+        }
+    }
+
+    int stopped = sender_stop(&sender);
+    ret = ret < LIBUSB_SUCCESS ? ret : stopped;
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    log_info("Animation stopped after %.1f ms - %u of %u frames played, %lu sent, %lu dropped by the device, %u late",
+        (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6, played, header.frames, sender.sent,
+        sender.mailbox.dropped, late);
+
+    close(timer);
+    munmap((void*)player.data, player.size);
+    device_disconnect(&transport);
+
+    return ret >= LIBUSB_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,104 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+
+#include "../args/args.h"
+#include "../device/frame.h"
+
+#define ANIMATION_MAGIC "CMXANIM"
+#define ANIMATION_VERSION 1
+#define ANIMATION_EXTENSION ".anim"
+
+#define ANIMATION_KEYFRAME 'K' // Record holding all key colors
+#define ANIMATION_DELTA 'D'    // Record holding the keys that changed since the previous frame
+
+/**
+ * @brief Header of an animation file. Followed by one record per frame.
+ */
+typedef struct
+{
+    /**
+     * @brief ANIMATION_MAGIC including the terminating zero.
+     */
+    char magic[8];
+
+    uint32_t version;
+
+    /**
+     * @brief Frames per second the animation is played with.
+     */
+    uint32_t fps;
+
+    /**
+     * @brief Number of frame records.
+     */
+    uint32_t frames;
+
+    /**
+     * @brief Every n-th frame is a keyframe, so damaged or skipped deltas do not persist.
+     */
+    uint32_t keyframe_interval;
+
+    uint8_t reserved[40];
+
+} animation_header_t;
+
+/**
+ * @brief Header of a frame record.
+ *
+ * A keyframe is followed by FRAME_KEYS colors of 3 bytes, padded to 4 bytes. A delta is followed by count entries of
+ * 4 bytes: key index, red, green and blue.
+ */
+typedef struct
+{
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t count;
+
+} animation_record_t;
+
+/**
+ * @brief Encodes the animation source in args into an animation file.
+ *
+ * The source holds "frame [RRGGBB]" lines that start a new frame, optionally filled with a color, "key NAME=RRGGBB ..."
+ * lines that change keys of the current frame and "repeat N" lines that show the current frame N more times. Frames
+ * start with the colors of the previous frame. The frame rate is taken from args->fps.
+ *
+ * @param args Application arguments.
+ * @return int EXIT_SUCCESS if the animation was written.
+ */
+int animation_encode_run(args_t* args);
+
+/**
+ * @brief Plays the animation file in args in CUSTOM mode.
+ *
+ * The file is mapped and decoded while playing, the pages already played are released again, so memory use does not
+ * grow with the length of the animation. Frames are uploaded by a separate thread, see sender_t. If the device is slower
+ * than the animation only the newest frame is uploaded, the timing of the animation is kept.
+ *
+ * @param args Application arguments.
+ * @return int EXIT_SUCCESS if the animation was played completely or interrupted.
+ */
+int animation_play_run(args_t* args);
@@ -0,0 +1,71 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stddef.h"
+#include "strings.h"
+
+#include "easing.h"
+
+bool easing_parse(const char* name, EASING* easing)
+{
+    static const struct {
+        const char* name;
+        EASING easing;
+    } easings[] = {
+        { "linear", EASING_LINEAR },
+        { "ease-in", EASING_IN },
+        { "ease-out", EASING_OUT },
+        { "ease-in-out", EASING_IN_OUT },
+    };
+
+    if (name == NULL || easing == NULL)
+        return false;
+
+    for (size_t i = 0; i < sizeof(easings) / sizeof(easings[0]); i++)
+    {
+        if (strcasecmp(name, easings[i].name) == 0)
+        {
+            *easing = easings[i].easing;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+float easing_apply(EASING easing, float t)
+{
+    switch (easing)
+    {
+    case EASING_IN:
+        return t * t * t;
+
+    case EASING_OUT:
+        return 1 - (1 - t) * (1 - t) * (1 - t);
+
+    case EASING_IN_OUT:
+        return t < 0.5f ? 4 * t * t * t : 1 - 4 * (1 - t) * (1 - t) * (1 - t);
+
+    default:
+        return t;
+    }
+}
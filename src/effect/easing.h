@@ -0,0 +1,56 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdbool.h"
+
+/**
+ * @brief Progress curve of a transition.
+ */
+typedef enum
+{
+    EASING_LINEAR = 0,
+    EASING_IN = 1,     // Starts slow
+    EASING_OUT = 2,    // Ends slow
+    EASING_IN_OUT = 3, // Starts and ends slow
+
+} EASING;
+
+/**
+ * @brief Parses the name of an easing curve.
+ *
+ * @param name linear, ease-in, ease-out or ease-in-out.
+ * @param easing Receives the curve.
+ * @return true The name is valid.
+ * @return false The name is invalid.
+ */
+bool easing_parse(const char* name, EASING* easing);
+
+/**
+ * @brief Applies the easing curve to linear progress.
+ *
+ * @param easing The curve.
+ * @param t Linear progress from 0 to 1.
+ * @return float Eased progress from 0 to 1.
+ */
+float easing_apply(EASING easing, float t);
@@ -0,0 +1,238 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "time.h"
+#include "errno.h"
+
+#include "fade.h"
+#include "../device/device.h"
+#include "../log/log.h"
+
+#define LINEAR_STEPS 4096 // Resolution of linear light used for interpolating
+
+static float to_linear[256];
+static uint8_t to_srgb[LINEAR_STEPS];
+static bool tables_ready;
+
+/**
+ * @brief Fills the conversion tables between sRGB and linear light.
+ */
+static void init_tables()
+{
+    if (tables_ready)
+        return;
+
+    for (int i = 0; i < 256; i++)
+    {
+        float c = i / 255.0f;
+        to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (int i = 0; i < LINEAR_STEPS; i++)
+    {
+        float l = i / (float)(LINEAR_STEPS - 1);
+        float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1 / 2.4f) - 0.055f;
+        to_srgb[i] = (uint8_t)lroundf(c * 255.0f);
+    }
+
+    tables_ready = true;
+}
+
+/**
+ * @brief Interpolates one channel in linear light.
+ */
+static uint8_t mix_channel(uint8_t from, uint8_t to, float t)
+{
+    float l = to_linear[from] + (to_linear[to] - to_linear[from]) * t;
+    return to_srgb[(int)(l * (LINEAR_STEPS - 1) + 0.5f)];
+}
+
+rgb_t fade_mix(rgb_t from, rgb_t to, float t)
+{
+    init_tables();
+
+    if (t <= 0)
+        return from;
+
+    if (t >= 1)
+        return to;
+
+    rgb_t mixed = {
+        mix_channel(from.red, to.red, t),
+        mix_channel(from.green, to.green, t),
+        mix_channel(from.blue, to.blue, t),
+    };
+
+    return mixed;
+}
+
+/**
+ * @brief Advances the given time.
+ */
+static void add_ns(struct timespec* ts, long ns)
+{
+    ts->tv_nsec += ns;
+
+    while (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+/**
+ * @brief Nanoseconds from a to b.
+ */
+static long long diff_ns(const struct timespec* a, const struct timespec* b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec);
+}
+
+int fade_run_on(transport_t* transport, rgb_t from, lighting_t target, unsigned int duration_ms, unsigned int fps, EASING easing)
+{
+    if (fps == 0)
+        fps = FADE_DEFAULT_FPS;
+
+    if (fps > FADE_MAX_FPS)
+        fps = FADE_MAX_FPS;
+
+    long period_ns = 1000000000L / fps;
+    long long duration_ns = (long long)duration_ms * 1000000LL;
+
+    rgb_t to = { target.red, target.green, target.blue };
+
+    lighting_t step = target;
+    step.mode = STATIC;
+    step.random_colors = false;
+
+    struct timespec start, deadline, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    deadline = start;
+
+    int sent = 0;
+    int skipped = 0;
+    rgb_t shown = from;
+    bool first = true;
+
+    while (1)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long elapsed = diff_ns(&start, &now);
+
+        float t = duration_ns > 0 ? (float)elapsed / duration_ns : 1;
+        rgb_t color = fade_mix(from, to, easing_apply(easing, t > 1 ? 1 : t));
+
+        // Unchanged colors are not sent again, so slow fades do not flood the device.
+        if (first || color.red != shown.red || color.green != shown.green || color.blue != shown.blue)
+        {
+            step.red = color.red;
+            step.green = color.green;
+            step.blue = color.blue;
+
+            int ret = device_apply_lighting(step, transport);
+
+            if (ret < LIBUSB_SUCCESS)
+            {
+                return ret;
+            }
+
+            shown = color;
+            first = false;
+            sent++;
+        }
+
+        if (t >= 1)
+        {
+            break;
+        }
+
+        add_ns(&deadline, period_ns);
+
+        // Behind schedule, skip the late frames instead of stretching the fade.
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        while (diff_ns(&deadline, &now) > period_ns)
+        {
+            add_ns(&deadline, period_ns);
+            skipped++;
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+            ;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    log_info("Fade finished after %.1f ms - %i reports sent, %i frames skipped", diff_ns(&start, &now) / 1e6, sent, skipped);
+
+    if (target.mode != STATIC)
+    {
+        int ret = device_apply_lighting(target, transport);
+        return ret < LIBUSB_SUCCESS ? ret : LIBUSB_SUCCESS;
+    }
+
+    return LIBUSB_SUCCESS;
+}
+
+void fade_run(args_t* args)
+{
+    lighting_t target;
+    args_to_lighting(args, &target);
+
+    transport_t transport;
+    cache_entry_t entry;
+    bool cached = device_connect_cached(args, &transport, &entry);
+
+    rgb_t from = { 0, 0, 0 };
+    lighting_t shown;
+
+    if (args->fade_from >= 0)
+    {
+        from.red = (args->fade_from >> 16) & 0xff;
+        from.green = (args->fade_from >> 8) & 0xff;
+        from.blue = args->fade_from & 0xff;
+    }
+    else if (cached && cache_load(&entry, &shown))
+    {
+        from.red = shown.red;
+        from.green = shown.green;
+        from.blue = shown.blue;
+    }
+
+    int ret = fade_run_on(&transport, from, target, args->fade_ms, args->fps, args->easing);
+
+    if (cached)
+    {
+        if (ret == LIBUSB_SUCCESS)
+            cache_store(&entry, &target);
+        else
+            cache_clear(&entry);
+    }
+
+    device_disconnect(&transport);
+
+    if (ret < LIBUSB_SUCCESS)
+    {
+        exit(EXIT_FAILURE);
+    }
+}
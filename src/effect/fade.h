@@ -0,0 +1,68 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdbool.h"
+
+#include "../args/args.h"
+#include "easing.h"
+#include "../device/frame.h"
+#include "../device/transport.h"
+
+#define FADE_DEFAULT_FPS 60 // Frames per second of a fade if not specified
+#define FADE_MAX_FPS 250    // Upper bound of the frame rate, the device does not take reports faster
+
+/**
+ * @brief Interpolates between two colors in linear light.
+ *
+ * @param from Start color.
+ * @param to End color.
+ * @param t Progress from 0 to 1.
+ * @return rgb_t The color at t.
+ */
+rgb_t fade_mix(rgb_t from, rgb_t to, float t);
+
+/**
+ * @brief Fades the device from one color to the target lighting by streaming STATIC reports.
+ *
+ * Frames are sent on a fixed schedule. If a transfer takes longer than a frame, the late frames are skipped instead of
+ * slowing down the fade. If the target is not STATIC the target lighting is applied after the fade.
+ *
+ * @param transport The opened device.
+ * @param from Start color.
+ * @param target Target lighting.
+ * @param duration_ms Duration of the fade.
+ * @param fps Frames per second.
+ * @param easing Progress curve.
+ * @return int LIBUSB_SUCCESS or a libusb error code.
+ */
+int fade_run_on(transport_t* transport, rgb_t from, lighting_t target, unsigned int duration_ms, unsigned int fps, EASING easing);
+
+/**
+ * @brief Main function for fading to the lighting given in args.
+ *
+ * The fade starts at args->fade_from or, if not given, at the last color applied to the device.
+ *
+ * @param args Application arguments.
+ */
+void fade_run(args_t* args);
@@ -0,0 +1,909 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "strings.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "signal.h"
+#include "time.h"
+#include "math.h"
+#include "dirent.h"
+#include "sys/epoll.h"
+#include "sys/timerfd.h"
+#include "sys/ioctl.h"
+#include "sys/stat.h"
+#include "linux/input.h"
+
+#include "reactive.h"
+#include "fade.h"
+#include "../device/device.h"
+#include "../device/layout.h"
+#include "../device/sender.h"
+#include "../log/log.h"
+
+#define REACTIVE_MAX_INPUTS 8    // Event devices read at once
+#define REACTIVE_MAX_RIPPLES 16  // Ripples shown at once, the oldest is replaced
+#define REACTIVE_LATENCY_SAMPLES 4096
+
+#define BENCH_PRESSES 500      // Key presses of the generated benchmark input
+#define BENCH_INTERVAL_MS 20   // Time between the generated key presses
+
+#define RIPPLE_SPEED 14.0f   // Key units per second
+#define RIPPLE_WIDTH 1.2f    // Key units
+#define RIPPLE_SECONDS 1.0f
+#define TRAIL_SECONDS 0.6f
+#define HEAT_HALF_LIFE 2.0f  // Seconds
+#define HEAT_PRESS 0.35f     // Heat added by a press, half of it to the neighbours
+
+/**
+ * @brief Supported reactions.
+ */
+typedef enum
+{
+    REACT_RIPPLE = 0,
+    REACT_TRAIL = 1,
+    REACT_HEAT = 2,
+
+} REACT_EFFECT;
+
+/**
+ * @brief Ripple started by a key press.
+ */
+typedef struct
+{
+    int key;
+    double start;
+
+} ripple_t;
+
+/**
+ * @brief State of the reactive mode.
+ */
+typedef struct
+{
+    REACT_EFFECT effect;
+    const layout_t* layout;
+    rgb_t color;
+
+    ripple_t ripples[REACTIVE_MAX_RIPPLES];
+    int ripple_count;
+
+    /**
+     * @brief Time of the last press per key, trail effect.
+     */
+    double pressed[LAYOUT_MAX_KEYS];
+
+    /**
+     * @brief Heat per key from 0 to 1, heat effect.
+     */
+    float heat[LAYOUT_MAX_KEYS];
+    double heat_updated;
+
+    /**
+     * @brief Time from the key event to the sent frame in microseconds. Written by the sending thread.
+     */
+    double latency[REACTIVE_LATENCY_SAMPLES];
+    int latency_count;
+
+    /**
+     * @brief Stamp of a frame with a key press that was dropped, carried over to the next frame.
+     */
+    uint64_t carried_stamp;
+
+} reactive_t;
+
+/**
+ * @brief Source of recorded events.
+ */
+typedef struct
+{
+    FILE* file;
+    struct input_event next;
+    bool pending;
+
+    /**
+     * @brief Maps the timestamps of the recording to the monotonic clock.
+     */
+    double offset;
+
+} recording_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    running = 0;
+}
+
+/**
+ * @brief Current time of the monotonic clock in seconds.
+ */
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Timestamp of an input event in seconds.
+ */
+static double event_time(const struct input_event* ev)
+{
+    return ev->input_event_sec + ev->input_event_usec / 1e6;
+}
+
+/**
+ * @brief Parses the name of a reaction.
+ */
+static bool parse_effect(const char* name, REACT_EFFECT* effect)
+{
+    static const char* names[] = { "ripple", "trail", "heat" };
+
+    for (int i = 0; name != NULL && i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcasecmp(name, names[i]) == 0)
+        {
+            *effect = (REACT_EFFECT)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Reads a hexadecimal id from sysfs.
+ */
+static int read_sysfs_id(const char* path)
+{
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    unsigned int id = 0;
+    int read = fscanf(file, "%x", &id);
+    fclose(file);
+
+    return read == 1 ? (int)id : -1;
+}
+
+/**
+ * @brief Opens the event devices of the keyboard that report keys.
+ *
+ * @param vendor Vendor id of the keyboard.
+ * @param product Product id of the keyboard.
+ * @param fds Receives the file descriptors.
+ * @return int Number of opened devices.
+ */
+static int open_keyboard_inputs(uint16_t vendor, uint16_t product, int* fds)
+{
+    DIR* dir = opendir("/sys/class/input");
+
+    if (dir == NULL)
+    {
+        return 0;
+    }
+
+    int count = 0;
+    struct dirent* ent;
+
+    while ((ent = readdir(dir)) != NULL && count < REACTIVE_MAX_INPUTS)
+    {
+        if (strncmp(ent->d_name, "event", 5) != 0)
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+
+        snprintf(path, sizeof(path), "/sys/class/input/%s/device/id/vendor", ent->d_name);
+        int dev_vendor = read_sysfs_id(path);
+
+        snprintf(path, sizeof(path), "/sys/class/input/%s/device/id/product", ent->d_name);
+        int dev_product = read_sysfs_id(path);
+
+        if (dev_vendor != vendor || dev_product != product)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/dev/input/%s", ent->d_name);
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+        if (fd < 0)
+        {
+            log_error("Error opening %s - %s", path, strerror(errno));
+            continue;
+        }
+
+        fds[count++] = fd;
+    }
+
+    closedir(dir);
+    return count;
+}
+
+/**
+ * @brief Stops watching an input device that is gone and closes it.
+ *
+ * @param epfd The epoll instance watching the inputs.
+ * @param inputs The open inputs.
+ * @param count Number of open inputs, decremented.
+ * @param fd The input to remove.
+ */
+static void remove_input(int epfd, int* inputs, int* count, int fd)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+
+    for (int i = 0; i < *count; i++)
+    {
+        if (inputs[i] == fd)
+        {
+            inputs[i] = inputs[--*count];
+            break;
+        }
+    }
+
+    if (*count == 0)
+    {
+        log_error("The key input is gone - Stopping.");
+    }
+}
+
+/**
+ * @brief Reads the next event of a recording.
+ */
+static void recording_advance(recording_t* recording)
+{
+    recording->pending = fread(&recording->next, sizeof(struct input_event), 1, recording->file) == 1;
+}
+
+/**
+ * @brief Decays the heat of all keys up to the given time.
+ *
+ * @param state The state.
+ * @param t The time.
+ */
+static void cool(reactive_t* state, double t)
+{
+    if (t <= state->heat_updated)
+    {
+        return;
+    }
+
+    float decay = state->heat_updated > 0 ? exp2f(-(t - state->heat_updated) / HEAT_HALF_LIFE) : 1;
+    state->heat_updated = t;
+
+    for (int i = 0; i < state->layout->count; i++)
+    {
+        state->heat[i] *= decay;
+
+        if (state->heat[i] < 1 / 255.0f)
+        {
+            state->heat[i] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Adds the reaction to a key press.
+ *
+ * @param state The state.
+ * @param code Input event code of the key.
+ * @param t Time of the press.
+ */
+static void press(reactive_t* state, uint16_t code, double t)
+{
+    int key = layout_find_code(state->layout, code);
+
+    if (key < 0)
+    {
+        return;
+    }
+
+    switch (state->effect)
+    {
+    case REACT_RIPPLE:
+    {
+        int slot = 0;
+
+        // Replace the oldest ripple if all are in use.
+        if (state->ripple_count < REACTIVE_MAX_RIPPLES)
+        {
+            slot = state->ripple_count++;
+        }
+        else
+        {
+            for (int i = 1; i < state->ripple_count; i++)
+            {
+                if (state->ripples[i].start < state->ripples[slot].start)
+                    slot = i;
+            }
+        }
+
+        state->ripples[slot].key = key;
+        state->ripples[slot].start = t;
+        break;
+    }
+
+    case REACT_TRAIL:
+        state->pressed[key] = t;
+        break;
+
+    case REACT_HEAT:
+        // Without rendered frames the heat was not decayed since the last frame.
+        cool(state, t);
+
+        state->heat[key] += HEAT_PRESS;
+
+        for (int i = 0; i < state->layout->neighbour_count[key]; i++)
+        {
+            state->heat[state->layout->neighbours[key][i]] += HEAT_PRESS / 2;
+        }
+
+        for (int i = 0; i < state->layout->count; i++)
+        {
+            if (state->heat[i] > 1)
+                state->heat[i] = 1;
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Scales the color by the given intensity from 0 to 1.
+ */
+static rgb_t scale(rgb_t color, float intensity)
+{
+    rgb_t scaled = { color.red * intensity, color.green * intensity, color.blue * intensity };
+    return scaled;
+}
+
+/**
+ * @brief Maps heat from 0 to 1 to black, red, yellow and white.
+ */
+static rgb_t heat_color(float heat)
+{
+    float v = heat * 3;
+
+    rgb_t color = {
+        v >= 1 ? 255 : v * 255,
+        v >= 2 ? 255 : v <= 1 ? 0 : (v - 1) * 255,
+        v >= 3 ? 255 : v <= 2 ? 0 : (v - 2) * 255,
+    };
+
+    return color;
+}
+
+/**
+ * @brief Renders the reactions at the given time.
+ *
+ * @param state The state.
+ * @param t The time.
+ * @param frame Receives the key colors.
+ * @return true The reactions are still changing, another frame is needed.
+ */
+static bool render(reactive_t* state, double t, frame_t* frame)
+{
+    const layout_t* layout = state->layout;
+    bool active = false;
+
+    frame_init(frame);
+
+    switch (state->effect)
+    {
+    case REACT_RIPPLE:
+    {
+        float intensity[LAYOUT_MAX_KEYS] = { 0 };
+
+        for (int r = 0; r < state->ripple_count; r++)
+        {
+            float age = t - state->ripples[r].start;
+
+            if (age >= RIPPLE_SECONDS)
+            {
+                state->ripples[r--] = state->ripples[--state->ripple_count];
+                continue;
+            }
+
+            float radius = age * RIPPLE_SPEED;
+            float fade = 1 - age / RIPPLE_SECONDS;
+            const float* distance = layout->distance[state->ripples[r].key];
+
+            for (int i = 0; i < layout->count; i++)
+            {
+                float d = distance[i] - radius;
+                d = d < 0 ? -d : d;
+
+                if (d < RIPPLE_WIDTH)
+                {
+                    float v = (1 - d / RIPPLE_WIDTH) * fade;
+                    intensity[i] = v > intensity[i] ? v : intensity[i];
+                }
+            }
+        }
+
+        for (int i = 0; i < layout->count; i++)
+        {
+            frame->keys[layout->led[i]] = scale(state->color, intensity[i]);
+        }
+
+        active = state->ripple_count > 0;
+        break;
+    }
+
+    case REACT_TRAIL:
+        for (int i = 0; i < layout->count; i++)
+        {
+            float age = t - state->pressed[i];
+
+            if (state->pressed[i] > 0 && age < TRAIL_SECONDS)
+            {
+                float v = 1 - age / TRAIL_SECONDS;
+                frame->keys[layout->led[i]] = scale(state->color, v * v);
+                active = true;
+            }
+        }
+        break;
+
+    case REACT_HEAT:
+    {
+        cool(state, t);
+
+        for (int i = 0; i < layout->count; i++)
+        {
+            if (state->heat[i] == 0)
+            {
+                continue;
+            }
+
+            frame->keys[layout->led[i]] = heat_color(state->heat[i]);
+            active = true;
+        }
+        break;
+    }
+    }
+
+    return active;
+}
+
+/**
+ * @brief Renders a frame and hands it to the sending thread.
+ *
+ * @param state The state.
+ * @param t The time.
+ * @param press Time of the first key event shown by the frame, 0 if none.
+ * @param sender The sending thread.
+ * @return true The reactions are still changing, another frame is needed.
+ */
+static bool show(reactive_t* state, double t, double press, sender_t* sender)
+{
+    mailbox_slot_t* slot = sender_frame(sender);
+    bool active = render(state, t, &slot->frame);
+
+    // A press whose frame was dropped is shown by this frame, so its latency is measured here.
+    slot->stamp = press > 0 ? (uint64_t)(press * 1e9) : 0;
+
+    if (state->carried_stamp != 0 && (slot->stamp == 0 || state->carried_stamp < slot->stamp))
+    {
+        slot->stamp = state->carried_stamp;
+    }
+
+    state->carried_stamp = sender_submit(sender) ? sender_frame(sender)->stamp : 0;
+
+    return active;
+}
+
+/**
+ * @brief Records the time from a key event until the upload of its frame started. Called by the sending thread.
+ *
+ * @param user The state.
+ * @param stamp Time of the key event in nanoseconds.
+ * @param issued Time the upload started in nanoseconds.
+ */
+static void add_latency(void* user, uint64_t stamp, uint64_t issued)
+{
+    reactive_t* state = user;
+
+    if (state->latency_count < REACTIVE_LATENCY_SAMPLES)
+    {
+        state->latency[state->latency_count++] = ((double)issued - (double)stamp) / 1e3;
+    }
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Logs the distribution of the key to LED latency.
+ *
+ * @param state The state.
+ * @return double The 99th percentile in microseconds.
+ */
+static double log_latency(reactive_t* state)
+{
+    int n = state->latency_count;
+
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    double mean = 0;
+    for (int i = 0; i < n; i++)
+    {
+        mean += state->latency[i] / n;
+    }
+
+    double variance = 0;
+    for (int i = 0; i < n; i++)
+    {
+        variance += (state->latency[i] - mean) * (state->latency[i] - mean) / n;
+    }
+
+    qsort(state->latency, n, sizeof(double), compare_double);
+
+    double p99 = state->latency[(n * 99) / 100];
+
+    log_info("Key to LED latency over %i presses - p50: %.0f us, p99: %.0f us, max: %.0f us, mean: %.0f us, jitter: %.0f us",
+        n, state->latency[n / 2], p99, state->latency[n - 1], mean, sqrt(variance));
+
+    return p99;
+}
+
+/**
+ * @brief Generates a recording of key presses on all keys for the benchmark.
+ *
+ * @param layout The layout.
+ * @return FILE* The recording, positioned at the start.
+ */
+static FILE* bench_input(const layout_t* layout)
+{
+    FILE* file = tmpfile();
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    int key = 0;
+    for (int i = 0; i < BENCH_PRESSES; i++)
+    {
+        // Fn has no event code.
+        do
+        {
+            key = (key + 7) % layout->count;
+        } while (layout->keys[key].code == 0);
+
+        long long us = (long long)i * BENCH_INTERVAL_MS * 1000;
+
+        struct input_event ev[3] = { 0 };
+        for (int j = 0; j < 3; j++)
+        {
+            ev[j].input_event_sec = us / 1000000;
+            ev[j].input_event_usec = us % 1000000;
+        }
+
+        ev[0].type = EV_KEY;
+        ev[0].code = layout->keys[key].code;
+        ev[0].value = 1;
+        ev[1].type = EV_SYN;
+        ev[2] = ev[0];
+        ev[2].value = 0;
+        ev[2].input_event_usec += 5000;
+
+        fwrite(ev, sizeof(ev), 1, file);
+    }
+
+    rewind(file);
+    return file;
+}
+
+void reactive_run(args_t* args)
+{
+    reactive_t* state = calloc(1, sizeof(reactive_t));
+
+    if (args->react == NULL && args->bench)
+    {
+        args->react = "ripple";
+    }
+
+    if (state == NULL || !parse_effect(args->react, &state->effect))
+    {
+        log_error("Unknown reactive effect %s. Expected RIPPLE, TRAIL or HEAT - Abort.", args->react);
+        exit(EXIT_FAILURE);
+    }
+
+    state->layout = layout_get();
+
+    if (args->bench)
+    {
+        args->transport = TRANSPORT_MOCK;
+    }
+    state->color.red = args->red;
+    state->color.green = args->green;
+    state->color.blue = args->blue;
+
+    if (state->color.red == 0 && state->color.green == 0 && state->color.blue == 0)
+    {
+        state->color.red = state->color.green = state->color.blue = 255;
+    }
+
+    int inputs[REACTIVE_MAX_INPUTS];
+    int input_count = 0;
+    recording_t recording = { 0 };
+
+    if (args->bench && args->input_path == NULL)
+    {
+        recording.file = bench_input(state->layout);
+
+        if (recording.file == NULL)
+        {
+            log_error("Error creating benchmark input - %s - Abort.", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (args->input_path != NULL)
+    {
+        struct stat st;
+
+        if (stat(args->input_path, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            recording.file = fopen(args->input_path, "rb");
+        }
+        else
+        {
+            int fd = open(args->input_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+            if (fd >= 0)
+            {
+                inputs[input_count++] = fd;
+            }
+        }
+
+        if (recording.file == NULL && input_count == 0)
+        {
+            log_error("Error opening %s - %s - Abort.", args->input_path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        uint16_t vendor = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
+        uint16_t product = args->product_id != -1 ? args->product_id : DEFAULT_PRODUCT_ID;
+
+        input_count = open_keyboard_inputs(vendor, product, inputs);
+
+        if (input_count == 0)
+        {
+            log_error("No input device of the keyboard found. Use --input to select one - Abort.");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // libusb would detach the keyboard driver, and with it the key events.
+    if (args->transport == TRANSPORT_LIBUSB)
+    {
+        log_info("Using the hidraw transport, so the keyboard keeps working.");
+        args->transport = TRANSPORT_HIDRAW;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    // Wakes up for animation frames and recorded events. Unlike the epoll timeout it is not rounded to milliseconds.
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event timer_ev = { .events = EPOLLIN, .data.fd = timer };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, timer, &timer_ev);
+
+    for (int i = 0; i < input_count; i++)
+    {
+        // Event timestamps on the monotonic clock allow measuring the latency.
+        int clock = CLOCK_MONOTONIC;
+        ioctl(inputs[i], EVIOCSCLOCKID, &clock);
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = inputs[i] };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, inputs[i], &ev);
+    }
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    lighting_t lighting;
+    args_to_lighting(args, &lighting);
+    lighting.mode = CUSTOM;
+    lighting.red = lighting.green = lighting.blue = 0;
+
+    if (device_apply_lighting(lighting, &transport) < LIBUSB_SUCCESS)
+    {
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int fps = args->fps > 0 ? args->fps : FADE_DEFAULT_FPS;
+
+    pacing_t pacing;
+    pacing_init(&pacing, args->target_latency_us, fps, args->verbose);
+
+    sender_t sender;
+
+    if (!sender_start(&sender, &transport, args->target_latency_us > 0 ? &pacing : NULL, add_latency, state))
+    {
+        log_error("Error starting the sending thread - Abort.");
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    if (recording.file != NULL)
+    {
+        recording_advance(&recording);
+        recording.offset = now() - (recording.pending ? event_time(&recording.next) : 0);
+    }
+
+    log_info("Reacting to key presses with %s", args->react);
+
+    double next_frame = 0;
+    bool active = false;
+
+    while (running && (input_count > 0 || recording.pending || active))
+    {
+        // Sleep until the next animation frame or recorded event, or until a key is pressed.
+        double wake = active ? next_frame : -1;
+
+        if (recording.pending)
+        {
+            double due = event_time(&recording.next) + recording.offset;
+            wake = wake < 0 || due < wake ? due : wake;
+        }
+
+        struct itimerspec its = { 0 };
+        if (wake >= 0)
+        {
+            // A zero value disarms the timer, so overdue wake ups are moved to the smallest possible time.
+            its.it_value.tv_sec = (time_t)wake;
+            its.it_value.tv_nsec = (long)((wake - (time_t)wake) * 1e9);
+            its.it_value.tv_nsec = its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0 ? 1 : its.it_value.tv_nsec;
+        }
+
+        timerfd_settime(timer, TFD_TIMER_ABSTIME, &its, NULL);
+
+        struct epoll_event events[REACTIVE_MAX_INPUTS + 1];
+        int ready = epoll_wait(epfd, events, REACTIVE_MAX_INPUTS + 1, -1);
+
+        if (ready < 0 && errno != EINTR)
+        {
+            log_error("Error waiting for key events - %s", strerror(errno));
+            break;
+        }
+
+        double t = now();
+        double first_press = 0;
+
+        for (int i = 0; i < ready; i++)
+        {
+            if (events[i].data.fd == timer)
+            {
+                uint64_t expirations;
+                while (read(timer, &expirations, sizeof(expirations)) > 0)
+                    ;
+
+                continue;
+            }
+
+            struct input_event ev[64];
+            ssize_t len;
+
+            while ((len = read(events[i].data.fd, ev, sizeof(ev))) > 0)
+            {
+                for (size_t j = 0; j < len / sizeof(struct input_event); j++)
+                {
+                    // Value 1 is a press, 2 an autorepeat and 0 a release.
+                    if (ev[j].type == EV_KEY && ev[j].value == 1)
+                    {
+                        press(state, ev[j].code, t);
+                        first_press = first_press > 0 ? first_press : event_time(&ev[j]);
+                    }
+                }
+            }
+
+            // An unplugged keyboard keeps the input readable with ENODEV, it would wake the loop forever.
+            if ((events[i].events & (EPOLLHUP | EPOLLERR)) != 0 || len == 0
+                || (len < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                remove_input(epfd, inputs, &input_count, events[i].data.fd);
+            }
+        }
+
+        while (recording.pending && event_time(&recording.next) + recording.offset <= t)
+        {
+            if (recording.next.type == EV_KEY && recording.next.value == 1)
+            {
+                press(state, recording.next.code, t);
+                first_press = first_press > 0 ? first_press : event_time(&recording.next) + recording.offset;
+            }
+
+            recording_advance(&recording);
+        }
+
+        // Presses are shown at once, animations at the frame rate.
+        if (first_press == 0 && (!active || t < next_frame))
+        {
+            continue;
+        }
+
+        if (sender_error(&sender) < LIBUSB_SUCCESS)
+        {
+            break;
+        }
+
+        active = show(state, t, first_press, &sender);
+        next_frame = t + 1.0 / pacing_fps(sender.pacing, fps);
+    }
+
+    sender_stop(&sender);
+
+    if (args->verbose)
+    {
+        log_info("Rendered %lu frames, %lu sent, %lu dropped", sender.mailbox.published, sender.sent, sender.mailbox.dropped);
+    }
+
+    double p99 = log_latency(state);
+
+    for (int i = 0; i < input_count; i++)
+    {
+        close(inputs[i]);
+    }
+
+    if (recording.file != NULL)
+    {
+        fclose(recording.file);
+    }
+
+    close(timer);
+    close(epfd);
+    free(state);
+
+    device_disconnect(&transport);
+
+    if (args->bench && args->bench_limit_us > 0 && p99 > args->bench_limit_us)
+    {
+        log_error("p99 latency of %.0f us exceeds the limit of %u us", p99, args->bench_limit_us);
+        exit(EXIT_FAILURE);
+    }
+}
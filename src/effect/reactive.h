@@ -0,0 +1,39 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "../args/args.h"
+
+/**
+ * @brief Main function of the reactive mode.
+ *
+ * Reads the key events of the keyboard and renders reactions to the pressed keys in CUSTOM mode. args->react selects the
+ * effect: ripple, trail or heat. Events are read from args->input if given, which can be an event device, i.e. a uinput
+ * device, or a recording of struct input_event. Otherwise the event devices of the keyboard are used.
+ *
+ * With args->bench the mock transport is used and the time from every key event until the transfer is issued is
+ * reported. Without input a generated sequence of key presses is replayed.
+ *
+ * @param args Application arguments.
+ */
+void reactive_run(args_t* args);
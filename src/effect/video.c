@@ -0,0 +1,583 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "signal.h"
+#include "pthread.h"
+#include "stdatomic.h"
+#include "time.h"
+
+#ifdef __SSE2__
+#include "emmintrin.h"
+#endif
+
+#include "video.h"
+#include "fade.h"
+#include "../device/device.h"
+#include "../device/layout.h"
+#include "../device/sender.h"
+#include "../log/log.h"
+#include "../stats/stats.h"
+
+#define VIDEO_MAGIC "YUV4MPEG2 "
+#define VIDEO_MAX_FRAME_HEADER 256
+#define VIDEO_DEFAULT_FPS 25 // Streams without frame rate
+
+/**
+ * @brief Pixel area covered by a key, x1 and y1 are exclusive.
+ */
+typedef struct
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+
+} video_rect_t;
+
+/**
+ * @brief Stream state, owned by the reader thread.
+ */
+typedef struct
+{
+    FILE* file;
+
+    int width;
+    int height;
+
+    /**
+     * @brief log2 of the chroma subsampling. -1 for streams without chroma planes.
+     */
+    int chroma_shift_x;
+    int chroma_shift_y;
+
+    /**
+     * @brief True for XCOLORRANGE=FULL, otherwise luma ranges from 16 to 235.
+     */
+    bool full_range;
+
+    /**
+     * @brief Frame rate as a fraction, frames are shown at num / den per second.
+     */
+    unsigned int fps_num;
+    unsigned int fps_den;
+
+    int chroma_width;
+    int chroma_height;
+    size_t frame_size;
+
+    /**
+     * @brief Samples of the current frame: luma, followed by the chroma planes.
+     */
+    uint8_t* planes;
+
+    video_rect_t luma[LAYOUT_MAX_KEYS];
+    video_rect_t chroma[LAYOUT_MAX_KEYS];
+
+    /**
+     * @brief Uploads the downsampled frames.
+     */
+    sender_t* sender;
+
+    /**
+     * @brief Set by the reader at the end of the stream.
+     */
+    atomic_bool done;
+
+    unsigned int frames;
+    uint64_t downsample_ns;
+
+    /**
+     * @brief Frames skipped because they were read after the next frame was due.
+     */
+    unsigned int late;
+
+} video_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    running = 0;
+}
+
+/**
+ * @brief Sums the samples of a rectangle of a plane.
+ *
+ * @param plane The plane.
+ * @param stride Width of the plane.
+ * @param rect The rectangle.
+ * @return uint32_t Sum of the samples.
+ */
+static uint32_t sum_rect(const uint8_t* plane, int stride, const video_rect_t* rect)
+{
+    int width = rect->x1 - rect->x0;
+    uint32_t sum = 0;
+
+#ifdef __SSE2__
+    // psadbw against zero adds up 8 bytes per 64 bit lane.
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int vector_width = width & ~15;
+
+    for (int y = rect->y0; y < rect->y1; y++)
+    {
+        const uint8_t* row = plane + (size_t)y * stride + rect->x0;
+
+        for (int x = 0; x < vector_width; x += 16)
+        {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(row + x)), zero));
+        }
+
+        for (int x = vector_width; x < width; x++)
+        {
+            sum += row[x];
+        }
+    }
+
+    sum += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+#else
+    for (int y = rect->y0; y < rect->y1; y++)
+    {
+        const uint8_t* row = plane + (size_t)y * stride + rect->x0;
+
+        for (int x = 0; x < width; x++)
+        {
+            sum += row[x];
+        }
+    }
+#endif
+
+    return sum;
+}
+
+/**
+ * @brief Average of the samples of a rectangle of a plane.
+ */
+static float average_rect(const uint8_t* plane, int stride, const video_rect_t* rect)
+{
+    return (float)sum_rect(plane, stride, rect) / ((rect->x1 - rect->x0) * (rect->y1 - rect->y0));
+}
+
+static uint8_t clamp_channel(float value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)(value + 0.5f);
+}
+
+/**
+ * @brief Computes the key colors of the current frame. Averages are taken in YCbCr and converted using BT.601.
+ *
+ * @param video The stream.
+ * @param frame Receives the key colors.
+ */
+static void downsample(const video_t* video, frame_t* frame)
+{
+    const layout_t* layout = layout_get();
+
+    const uint8_t* luma = video->planes;
+    const uint8_t* cb = luma + (size_t)video->width * video->height;
+    const uint8_t* cr = cb + (size_t)video->chroma_width * video->chroma_height;
+
+    for (int i = 0; i < layout->count; i++)
+    {
+        float y = average_rect(luma, video->width, &video->luma[i]);
+        float u = 0;
+        float v = 0;
+
+        if (video->chroma_shift_x >= 0)
+        {
+            u = average_rect(cb, video->chroma_width, &video->chroma[i]) - 128;
+            v = average_rect(cr, video->chroma_width, &video->chroma[i]) - 128;
+        }
+
+        rgb_t color;
+
+        if (video->full_range)
+        {
+            color.red = clamp_channel(y + 1.402f * v);
+            color.green = clamp_channel(y - 0.344f * u - 0.714f * v);
+            color.blue = clamp_channel(y + 1.772f * u);
+        }
+        else
+        {
+            y = 1.164f * (y - 16);
+            color.red = clamp_channel(y + 1.596f * v);
+            color.green = clamp_channel(y - 0.392f * u - 0.813f * v);
+            color.blue = clamp_channel(y + 2.017f * u);
+        }
+
+        frame_set_key(frame, layout->led[i], color);
+    }
+}
+
+/**
+ * @brief Maps the keys to pixel areas. Every key covers at least one pixel.
+ *
+ * @param video The stream, width, height and the chroma subsampling must be set.
+ */
+static void map_keys(video_t* video)
+{
+    const layout_t* layout = layout_get();
+
+    float scale_x = video->width / layout->width;
+    float scale_y = video->height / layout->height;
+
+    for (int i = 0; i < layout->count; i++)
+    {
+        const layout_key_t* key = &layout->keys[i];
+        video_rect_t* rect = &video->luma[i];
+
+        rect->x0 = (int)(key->x * scale_x);
+        rect->y0 = (int)(key->y * scale_y);
+        rect->x1 = (int)((key->x + key->width) * scale_x);
+        rect->y1 = (int)((key->y + key->height) * scale_y);
+
+        rect->x0 = rect->x0 < video->width ? rect->x0 : video->width - 1;
+        rect->y0 = rect->y0 < video->height ? rect->y0 : video->height - 1;
+        rect->x1 = rect->x1 > rect->x0 ? (rect->x1 < video->width ? rect->x1 : video->width) : rect->x0 + 1;
+        rect->y1 = rect->y1 > rect->y0 ? (rect->y1 < video->height ? rect->y1 : video->height) : rect->y0 + 1;
+
+        if (video->chroma_shift_x >= 0)
+        {
+            video_rect_t* chroma = &video->chroma[i];
+
+            chroma->x0 = rect->x0 >> video->chroma_shift_x;
+            chroma->y0 = rect->y0 >> video->chroma_shift_y;
+            chroma->x1 = (rect->x1 + (1 << video->chroma_shift_x) - 1) >> video->chroma_shift_x;
+            chroma->y1 = (rect->y1 + (1 << video->chroma_shift_y) - 1) >> video->chroma_shift_y;
+        }
+    }
+}
+
+/**
+ * @brief Reads and validates the stream header.
+ *
+ * @param video The stream. Receives the frame geometry.
+ * @return true The stream can be played.
+ */
+static bool read_header(video_t* video)
+{
+    char* line = NULL;
+    size_t len = 0;
+
+    if (getline(&line, &len, video->file) < 0 || strncmp(line, VIDEO_MAGIC, strlen(VIDEO_MAGIC)) != 0)
+    {
+        log_error("Not a YUV4MPEG2 stream.");
+        free(line);
+        return false;
+    }
+
+    const char* colorspace = "420";
+    bool valid = true;
+
+    video->fps_num = VIDEO_DEFAULT_FPS;
+    video->fps_den = 1;
+
+    char* save = NULL;
+    for (char* token = strtok_r(line + strlen(VIDEO_MAGIC), " \n", &save); token != NULL; token = strtok_r(NULL, " \n", &save))
+    {
+        if (token[0] == 'W')
+        {
+            video->width = atoi(token + 1);
+        }
+        else if (token[0] == 'H')
+        {
+            video->height = atoi(token + 1);
+        }
+        else if (token[0] == 'C')
+        {
+            colorspace = token + 1;
+        }
+        else if (token[0] == 'F')
+        {
+            if (sscanf(token + 1, "%u:%u", &video->fps_num, &video->fps_den) != 2 || video->fps_num == 0 || video->fps_den == 0)
+            {
+                log_error("Invalid frame rate %s.", token + 1);
+                valid = false;
+            }
+        }
+        else if (strcmp(token, "XCOLORRANGE=FULL") == 0)
+        {
+            video->full_range = true;
+        }
+    }
+
+    // Only the 8 bit variants, 420p10 and the like are not supported. The suffixes of 420 name the chroma siting.
+    if (strcmp(colorspace, "420") == 0 || strcmp(colorspace, "420jpeg") == 0 || strcmp(colorspace, "420paldv") == 0
+        || strcmp(colorspace, "420mpeg2") == 0)
+    {
+        video->chroma_shift_x = 1;
+        video->chroma_shift_y = 1;
+    }
+    else if (strcmp(colorspace, "422") == 0)
+    {
+        video->chroma_shift_x = 1;
+        video->chroma_shift_y = 0;
+    }
+    else if (strcmp(colorspace, "444") == 0)
+    {
+        video->chroma_shift_x = 0;
+        video->chroma_shift_y = 0;
+    }
+    else if (strcmp(colorspace, "mono") == 0)
+    {
+        video->chroma_shift_x = -1;
+        video->chroma_shift_y = -1;
+    }
+    else
+    {
+        log_error("Unsupported color space %s.", colorspace);
+        valid = false;
+    }
+
+    if (video->width <= 0 || video->height <= 0 || video->width > VIDEO_MAX_WIDTH || video->height > VIDEO_MAX_HEIGHT)
+    {
+        log_error("Unsupported frame size %ix%i.", video->width, video->height);
+        valid = false;
+    }
+
+    free(line);
+
+    if (!valid)
+    {
+        return false;
+    }
+
+    if (video->chroma_shift_x >= 0)
+    {
+        video->chroma_width = (video->width + (1 << video->chroma_shift_x) - 1) >> video->chroma_shift_x;
+        video->chroma_height = (video->height + (1 << video->chroma_shift_y) - 1) >> video->chroma_shift_y;
+    }
+
+    video->frame_size = (size_t)video->width * video->height + 2 * (size_t)video->chroma_width * video->chroma_height;
+
+    return true;
+}
+
+/**
+ * @brief Reads the next frame into the planes.
+ *
+ * @param video The stream.
+ * @return true A whole frame was read.
+ */
+static bool read_frame(video_t* video)
+{
+    char header[VIDEO_MAX_FRAME_HEADER];
+    size_t len = 0;
+    int c;
+
+    // "FRAME" optionally followed by parameters that do not matter here.
+    while ((c = getc(video->file)) != EOF && c != '\n')
+    {
+        if (len < sizeof(header) - 1)
+        {
+            header[len++] = c;
+        }
+    }
+
+    header[len] = '\0';
+
+    if (c == EOF || strncmp(header, "FRAME", 5) != 0)
+    {
+        return false;
+    }
+
+    return fread(video->planes, 1, video->frame_size, video->file) == video->frame_size;
+}
+
+/**
+ * @brief Reads and downsamples all frames and hands them to the sending thread at the frame rate of the stream. If the
+ * device is slower than the video the sending thread drops all but the newest frame.
+ *
+ * Frames are due on an absolute schedule, so a stream read faster than real time, i.e. a file, is not played too fast.
+ * A frame read after the next one was due is skipped.
+ */
+static void* reader_run(void* arg)
+{
+    video_t* video = arg;
+
+    uint64_t first = 0;
+    uint64_t period_ns = 1000000000ULL * video->fps_den / video->fps_num;
+
+    for (uint64_t i = 0; read_frame(video) && sender_error(video->sender) == LIBUSB_SUCCESS; i++)
+    {
+        uint64_t start = stats_now();
+
+        // The schedule starts with the first frame, waiting for a live source to start is not late.
+        if (i == 0)
+        {
+            first = start;
+        }
+
+        uint64_t due = first + (uint64_t)((double)i * 1e9 * video->fps_den / video->fps_num);
+
+        if (start > due + period_ns)
+        {
+            video->late++;
+            continue;
+        }
+
+        struct timespec deadline = { due / 1000000000ULL, due % 1000000000ULL };
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        {
+        }
+
+        start = stats_now();
+
+        mailbox_slot_t* slot = sender_frame(video->sender);
+        downsample(video, &slot->frame);
+        slot->stamp = 0;
+
+        video->downsample_ns += stats_now() - start;
+        video->frames++;
+
+        sender_submit(video->sender);
+    }
+
+    atomic_store(&video->done, true);
+
+    return NULL;
+}
+
+int video_run(args_t* args)
+{
+    video_t video;
+    memset(&video, 0, sizeof(video));
+
+    video.file = stdin;
+
+    if (strcmp(args->video_path, "-") != 0)
+    {
+        video.file = fopen(args->video_path, "rb");
+
+        if (video.file == NULL)
+        {
+            log_error("Error opening %s - %s - Abort.\n", args->video_path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!read_header(&video))
+    {
+        log_error("Error reading %s - Abort.\n", args->video_path);
+        exit(EXIT_FAILURE);
+    }
+
+    video.planes = malloc(video.frame_size);
+
+    if (video.planes == NULL)
+    {
+        log_error("Out of memory - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    map_keys(&video);
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    lighting_t lighting;
+    args_to_lighting(args, &lighting);
+    lighting.mode = CUSTOM;
+    lighting.red = lighting.green = lighting.blue = 0;
+
+    if (device_apply_lighting(lighting, &transport) < LIBUSB_SUCCESS)
+    {
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    // The video keeps its frame rate, pacing only limits the reports per upload.
+    pacing_t pacing;
+    pacing_init(&pacing, args->target_latency_us, FADE_MAX_FPS, args->verbose);
+
+    sender_t sender;
+
+    if (!sender_start(&sender, &transport, args->target_latency_us > 0 ? &pacing : NULL, NULL, NULL))
+    {
+        log_error("Error starting the sending thread - Abort.\n");
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    video.sender = &sender;
+    atomic_init(&video.done, false);
+
+    // The reader must not take signals meant for this thread.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    pthread_t reader;
+    int created = pthread_create(&reader, NULL, reader_run, &video);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (created != 0)
+    {
+        log_error("Error starting the reader thread - Abort.\n");
+        sender_stop(&sender);
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    // Only waits for the end of the stream or a signal, reading and sending happen on their own threads.
+    struct timespec interval = { 0, 100000000L };
+
+    while (running && !atomic_load(&video.done) && sender_error(&sender) == LIBUSB_SUCCESS)
+    {
+        nanosleep(&interval, NULL);
+    }
+
+    // Interrupted or failed, the reader might be blocked waiting for input.
+    if (!atomic_load(&video.done))
+    {
+        pthread_cancel(reader);
+    }
+
+    pthread_join(reader, NULL);
+
+    int ret = sender_stop(&sender);
+
+    log_info("Video stopped - %u frames shown, %u late, %lu sent, %lu dropped, %.2f ms downsampling per frame", video.frames,
+        video.late, sender.sent, sender.mailbox.dropped, video.frames > 0 ? video.downsample_ns / 1e6 / video.frames : 0);
+
+    free(video.planes);
+
+    if (video.file != stdin)
+    {
+        fclose(video.file);
+    }
+
+    device_disconnect(&transport);
+
+    return ret >= LIBUSB_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
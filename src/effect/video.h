@@ -0,0 +1,41 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "../args/args.h"
+
+#define VIDEO_MAX_WIDTH 7680
+#define VIDEO_MAX_HEIGHT 4320
+
+/**
+ * @brief Shows a raw video in CUSTOM mode.
+ *
+ * args->video_path is a YUV4MPEG2 stream with 8 bit samples (4:2:0, 4:2:2, 4:4:4 or mono), "-" reads stdin. Every
+ * frame is scaled to the keyboard and each key gets the average color of the area it covers. Frames are read and
+ * downsampled by a separate thread. If the device is slower than the video, only the newest frame is sent and the
+ * others are dropped.
+ *
+ * @param args Application arguments.
+ * @return int EXIT_SUCCESS if the stream was played completely or interrupted.
+ */
+int video_run(args_t* args);
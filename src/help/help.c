@@ -42,8 +42,46 @@ void help_print()
     printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "-r", "--random-colors", "", "Applies random colors for lighting if applicable.\n");
     printf("%-5s%-10s%-20s\t%s\t%s", " ", "", "--vendor-id", "[VENDOR]", "Specifies an explicit vendor id to look for when searching for the device. If not specified standard value is set.\n");
     printf("%-5s%-10s%-20s\t%s\t%s", " ", "", "--product-id", "[PRODUCT]", "Specifies an explicit product id to look for when searching for the device. If not specified standard value is set.\n");
+    printf("%-5s%-10s%-20s\t%s\t%s", " ", "", "--transport", "[TRANSPORT]", "LIBUSB (default), HIDRAW or MOCK. HIDRAW sends the reports via /dev/hidrawN and keeps the keyboard driver bound. MOCK simulates the device.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--mock-latency", "[US]", "Simulated duration of every mock transfer in microseconds.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--mock-fail-every", "[N]", "Every n-th mock transfer fails.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--mock-error", "[ERROR]", "Error of failing mock transfers. IO (default), PIPE, BUSY, NO_DEVICE or TIMEOUT.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--record", "[FILE]", "Records all sent reports with their timestamps to the file.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--replay", "[FILE]", "Sends the reports of a recording with the recorded timing instead of setting the lighting.\n");
     printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "-v", "--verbose", "", "Verbose outout. Including libusb debug messages.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--log-level", "[LEVEL]", "Minimum level of printed messages. DEBUG, INFO (default), ERROR or NONE. Errors are printed to stderr.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--stats", "[FORMAT]", "Prints the time spent in each phase and the transfer counters at exit. JSON or PROMETHEUS.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--stats-file", "[FILE]", "Writes the statistics to the file instead of stdout. The file is replaced atomically.\n");
     printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--version", "", "Prints the version number.\n");
+    printf("%-5s%-10s%-20s\t%s\t%s", " ", "", "--react", "[EFFECT]", "Lights up pressed keys. RIPPLE, TRAIL or HEAT. Uses the given color and --fps for the animation.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--input", "[FILE]", "Event device (i.e. uinput) or recording of input events to react to instead of the keyboard.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--bench", "", "Measures the key to LED latency of the reactive mode against the mock device. Uses --input or generated key presses.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--bench-limit", "[US]", "The benchmark fails if the 99th percentile of the latency exceeds the limit.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--compile", "[FILE]", "Compiles a batch file into a profile of ready to send reports. Delays are not allowed.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--output", "[FILE]", "Path of the compiled profile. Defaults to ~/.local/share/cherrymxboard30s-rgb/profiles/NAME.prof.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--profile", "[NAME]", "Applies a compiled profile by name or path.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--animate", "[FILE]", "Plays an animation file with per key colors.\n");
+    printf("%-5s%-10s%-20s\t%s\t%s", " ", "", "--encode-animation", "[FILE]", "Encodes an animation source into an animation file at --fps. Written to --output or next to the source.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--video", "[FILE]", "Shows a YUV4MPEG2 video (- for stdin) scaled down to the keys. Frames the device cannot keep up with are dropped.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--shm", "", "Shows the per key frames other programs publish to shared memory, see src/shm/shm_ring.h.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--shm-name", "[NAME]", "Name of the shared memory. Defaults to /cherrymxboard30s-rgb.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--target-latency", "[US]", "Adapts frame rate and reports per frame of streamed effects to the measured transfer times. Defaults to 16000, 0 disables.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--gamma", "[GAMMA]", "Gamma applied to all colors before sending them, i.e. 2.2. Defaults to 1 (unchanged).\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--intensity", "[0 - 100]", "Scales all colors in percent.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--white-point", "[RRGGBB]", "Color sent for white, scales the channels to correct the LED tint.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--temperature", "[KELVIN]", "Shifts all colors to the given color temperature, relative to 6500 K.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--lut", "[FILE]", "Calibration 3D LUT in the .cube format applied after the other corrections.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--fade", "[MS]", "Fades from the current color to the given color within the given time by streaming STATIC reports.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--from", "[RRGGBB]", "Color the fade starts at. Defaults to the last applied color.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--easing", "[EASING]", "Progress curve of the fade. LINEAR, EASE-IN, EASE-OUT or EASE-IN-OUT (default).\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--fps", "[N]", "Frames per second of the fade. Defaults to 60.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--force", "", "Sends the lighting even if --cache knows the device to show it already.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--cache", "", "Skips the lighting if it was the last one applied to the device since it was plugged in. Changes made on the keyboard are not noticed.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "-a", "--all", "", "Applies the lighting to all matching devices in parallel instead of asking for one.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--batch", "[FILE]", "Executes the lighting commands of the file (- for stdin) on one USB session.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "-D", "--daemon", "", "Runs as daemon that keeps the device open and applies lighting commands received on the socket.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "-w", "--watch", "", "Keeps running and applies the lighting whenever the device is connected, i.e. after replugging or resuming.\n");
+    printf("%-5s%-10s%-20s\t%s\t\t%s", " ", "", "--socket", "[PATH]", "Path of the daemon socket. Defaults to $XDG_RUNTIME_DIR/cherrymxboard30s-rgb.sock.\n");
     printf("\n");
     printf("Possible lighting modes:\n");
     printf("\n");
@@ -60,6 +98,7 @@ void help_print()
     printf("%-10s%-20s\n", " ", "STATIC");
     printf("\n");
     printf("Remarks: Using cherrymxboard30s-rgb requires sudo permissions if no udev rules are defined.\n");
+    printf("If a daemon is listening on the socket the lighting is sent to the daemon instead of opening the device.\n");
     printf("For more information see " GREEN(PROJECT_URL) ".\n");
     printf("\n");
 }
@@ -21,76 +21,351 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE. */
 
 #include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "strings.h"
 #include "time.h"
 #include "stdarg.h"
+#include "stdint.h"
+#include "stdatomic.h"
+#include "pthread.h"
+#include "semaphore.h"
+#include "signal.h"
+#include "sched.h"
 
 #include "log.h"
 #include "../color/color.h"
 
-static void timestamp(char* into)
+#define LOG_RING_SIZE 256    // Number of queued messages, power of two
+#define LOG_MESSAGE_LEN 512  // Maximum length of a formatted message
+#define LOG_TIMESTAMP_LEN 20 // Length of a formatted timestamp including the terminator
+
+/**
+ * @brief A queued message.
+ */
+typedef struct
+{
+    /**
+     * @brief Position in the ring this slot is ready for. Equals position + 1 once the message is written.
+     */
+    atomic_size_t sequence;
+
+    /**
+     * @brief Level of the message.
+     */
+    LOG_LEVEL level;
+
+    /**
+     * @brief Time the message was logged.
+     */
+    time_t time;
+
+    /**
+     * @brief The formatted message.
+     */
+    char message[LOG_MESSAGE_LEN];
+
+} record_t;
+
+static record_t ring[LOG_RING_SIZE];
+static atomic_size_t head;
+static size_t tail;
+
+static atomic_int min_level = LOG_LEVEL_INFO;
+static atomic_bool running;
+static atomic_bool stopping;
+static atomic_int submitting; // Threads between the running check and publishing their message
+static pthread_t drainer;
+static sem_t pending;
+
+/**
+ * @brief Formats the given time. The last formatted second is cached per thread.
+ *
+ * @param t The time.
+ * @return const char* The formatted time.
+ */
+static const char* timestamp(time_t t)
+{
+    static __thread time_t cached = -1;
+    static __thread char ts[LOG_TIMESTAMP_LEN];
+
+    if (t != cached)
+    {
+        struct tm ti;
+        localtime_r(&t, &ti);
+
+        snprintf(ts, sizeof(ts), "%u-%02u-%02uT%02u:%02u:%02u", 1900 + ti.tm_year, ti.tm_mon + 1, ti.tm_mday, ti.tm_hour, ti.tm_min, ti.tm_sec);
+        cached = t;
+    }
+
+    return ts;
+}
+
+/**
+ * @brief Writes a message as one line. Errors go to stderr, everything else to stdout.
+ *
+ * @param level Level of the message.
+ * @param t Time the message was logged.
+ * @param message The message.
+ */
+static void write_line(LOG_LEVEL level, time_t t, const char* message)
+{
+    const char* tag;
+    FILE* out = stdout;
+
+    switch (level)
+    {
+    case LOG_LEVEL_DEBUG:
+        tag = YELLOW("DEBUG ");
+        break;
+
+    case LOG_LEVEL_ERROR:
+        tag = RED("ERROR ");
+        out = stderr;
+        break;
+
+    default:
+        tag = BLUE("INFO  ");
+        break;
+    }
+
+    fprintf(out, "%s %s%s\n", timestamp(t), tag, message);
+}
+
+/**
+ * @brief Writes all queued messages. Only called by one thread at a time.
+ *
+ * @return int Number of written messages.
+ */
+static int drain()
+{
+    int written = 0;
+
+    while (1)
+    {
+        record_t* record = &ring[tail & (LOG_RING_SIZE - 1)];
+
+        if (atomic_load_explicit(&record->sequence, memory_order_acquire) != tail + 1)
+        {
+            break;
+        }
+
+        write_line(record->level, record->time, record->message);
+
+        atomic_store_explicit(&record->sequence, tail + LOG_RING_SIZE, memory_order_release);
+        tail++;
+        written++;
+    }
+
+    if (written > 0)
+    {
+        fflush(stdout);
+    }
+
+    return written;
+}
+
+/**
+ * @brief Background thread writing queued messages until log_stop.
+ */
+static void* drain_run(void* arg)
+{
+    while (1)
+    {
+        sem_wait(&pending);
+        drain();
+
+        if (atomic_load(&stopping))
+        {
+            drain();
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Queues a message, or writes it directly if the background thread is not running. If the ring is full the
+ * caller waits until the background thread made room, writing directly would put the message before older ones.
+ *
+ * @param level Level of the message.
+ * @param fmt Format string for message.
+ * @param args Variadic arguments.
+ */
+static void submit(LOG_LEVEL level, const char* fmt, va_list args)
+{
+    if (!fmt || (int)level < atomic_load_explicit(&min_level, memory_order_relaxed))
+        return;
+
+    time_t now = time(NULL);
+
+    // Announced before running is checked, so log_stop waits for this message before the last drain.
+    atomic_fetch_add(&submitting, 1);
+
+    if (atomic_load(&running))
+    {
+        size_t pos = atomic_load_explicit(&head, memory_order_relaxed);
+
+        while (1)
+        {
+            record_t* record = &ring[pos & (LOG_RING_SIZE - 1)];
+            size_t seq = atomic_load_explicit(&record->sequence, memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0)
+            {
+                if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                {
+                    record->level = level;
+                    record->time = now;
+                    vsnprintf(record->message, sizeof(record->message), fmt, args);
+
+                    atomic_store_explicit(&record->sequence, pos + 1, memory_order_release);
+                    sem_post(&pending);
+                    atomic_fetch_sub(&submitting, 1);
+                    return;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Full, the background thread keeps draining until log_stop saw this message.
+                struct timespec pause = { 0, 50000 };
+                sem_post(&pending);
+                nanosleep(&pause, NULL);
+
+                pos = atomic_load_explicit(&head, memory_order_relaxed);
+            }
+            else
+            {
+                pos = atomic_load_explicit(&head, memory_order_relaxed);
+            }
+        }
+    }
+
+    atomic_fetch_sub(&submitting, 1);
+
+    char message[LOG_MESSAGE_LEN];
+    vsnprintf(message, sizeof(message), fmt, args);
+
+    write_line(level, now, message);
+}
+
+void log_start()
 {
-    if (!into)
+    if (atomic_load(&running))
         return;
 
-    time_t rawtime;
-    struct tm* ti;
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+    {
+        atomic_init(&ring[i].sequence, i);
+    }
 
-    time(&rawtime);
-    ti = localtime(&rawtime);
+    atomic_store(&head, 0);
+    tail = 0;
+    atomic_store(&stopping, false);
 
-    sprintf(into, "%u-%02u-%02uT%02u:%02u:%02u", 1900 + ti->tm_year, ti->tm_mon + 1, ti->tm_mday, ti->tm_hour, ti->tm_min, ti->tm_sec);
+    if (sem_init(&pending, 0, 0) != 0)
+        return;
+
+    // The drain thread must not take signals meant for the main thread.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    int ret = pthread_create(&drainer, NULL, drain_run, NULL);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (ret != 0)
+    {
+        sem_destroy(&pending);
+        return;
+    }
+
+    static bool registered = false;
+    if (!registered)
+    {
+        atexit(log_stop);
+        registered = true;
+    }
+
+    atomic_store_explicit(&running, true, memory_order_release);
 }
 
-void log_info(const char* fmt, ...)
+void log_stop()
 {
-    if (!fmt)
+    if (!atomic_exchange(&running, false))
         return;
 
-    char ts[20];
-    timestamp(ts);
+    // Threads that saw running before it was cleared are still queueing, the background thread drains for them.
+    while (atomic_load(&submitting) > 0)
+    {
+        sem_post(&pending);
+        sched_yield();
+    }
+
+    atomic_store(&stopping, true);
+    sem_post(&pending);
+    pthread_join(drainer, NULL);
 
+    // Messages queued while stopping.
+    drain();
+    sem_destroy(&pending);
+
+    fflush(stdout);
+}
+
+void log_set_level(LOG_LEVEL level)
+{
+    atomic_store(&min_level, level);
+}
+
+bool log_level_parse(const char* name, LOG_LEVEL* level)
+{
+    static const char* names[] = { "debug", "info", "error", "none" };
+
+    if (!name || !level)
+        return false;
+
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcasecmp(name, names[i]) == 0)
+        {
+            *level = (LOG_LEVEL)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void log_info(const char* fmt, ...)
+{
     va_list args;
     va_start(args, fmt);
 
-    printf("%s " BLUE("INFO  "), ts);
-    vfprintf(stdout, fmt, args);
-    printf("\n");
+    submit(LOG_LEVEL_INFO, fmt, args);
 
     va_end(args);
 }
 
 void log_debug(const char* fmt, ...)
 {
-    if (!fmt)
-        return;
-
-    char ts[20];
-    timestamp(ts);
-
     va_list args;
     va_start(args, fmt);
 
-    printf("%s " YELLOW("DEBUG "), ts);
-    vfprintf(stdout, fmt, args);
-    printf("\n");
+    submit(LOG_LEVEL_DEBUG, fmt, args);
 
     va_end(args);
 }
 
 void log_error(const char* fmt, ...)
 {
-    if (!fmt)
-        return;
-
-    char ts[20];
-    timestamp(ts);
-
     va_list args;
     va_start(args, fmt);
 
-    printf("%s " RED("ERROR "), ts);
-    vfprintf(stdout, fmt, args);
-    printf("\n");
+    submit(LOG_LEVEL_ERROR, fmt, args);
 
     va_end(args);
 }
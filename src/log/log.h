@@ -22,6 +22,50 @@ SOFTWARE. */
 
 #pragma once
 
+#include "stdbool.h"
+
+/**
+ * @brief Severity of a log message. Messages below the configured level are discarded.
+ */
+typedef enum
+{
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO = 1,
+    LOG_LEVEL_ERROR = 2,
+    LOG_LEVEL_NONE = 3
+
+} LOG_LEVEL;
+
+/**
+ * @brief Starts the background thread writing the log. Until then and after log_stop messages are written directly.
+ *
+ * Messages are queued in a lock-free ring and written by the background thread, so logging does not block on stdout.
+ * The log is flushed at exit.
+ */
+void log_start();
+
+/**
+ * @brief Writes all queued messages and stops the background thread.
+ */
+void log_stop();
+
+/**
+ * @brief Sets the minimum level of messages to write.
+ *
+ * @param level The level.
+ */
+void log_set_level(LOG_LEVEL level);
+
+/**
+ * @brief Parses the name of a log level.
+ *
+ * @param name debug, info, error or none.
+ * @param level Receives the level.
+ * @return true The name is valid.
+ * @return false The name is invalid.
+ */
+bool log_level_parse(const char* name, LOG_LEVEL* level);
+
 /**
  * @brief Prints out given message as INFO.
  *
@@ -39,9 +83,9 @@ void log_info(const char* fmt, ...);
 void log_debug(const char* fmt, ...);
 
 /**
- * @brief Prints out given message as ERROR.
+ * @brief Prints out given message as ERROR. Errors are written to stderr.
  *
  * @param fmt Format string for message.
  * @param ... Variadic arguments.
  */
-void log_error(const char* fmt, ...);
\ No newline at end of file
+void log_error(const char* fmt, ...);
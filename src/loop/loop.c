@@ -0,0 +1,334 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "signal.h"
+#include "unistd.h"
+#include "sys/signalfd.h"
+#include "sys/timerfd.h"
+
+#include "loop.h"
+#include "../log/log.h"
+
+#define NS_PER_SEC 1000000000ULL
+
+/**
+ * @brief Returns the signals handled by the loop.
+ */
+static sigset_t loop_signals(void)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+    return mask;
+}
+
+static void on_signal(loop_t* loop, int fd, uint32_t events, void* user)
+{
+    struct signalfd_siginfo info;
+
+    while (read(fd, &info, sizeof(info)) == sizeof(info))
+    {
+        loop_stop(loop);
+    }
+}
+
+static void on_usb(loop_t* loop, int fd, uint32_t events, void* user)
+{
+    loop->usb_ready = true;
+}
+
+static void LIBUSB_CALL on_pollfd_added(int fd, short events, void* user_data)
+{
+    // The poll and epoll event flags have the same values.
+    if (!loop_add(user_data, fd, events, on_usb, NULL))
+    {
+        log_error("Cannot watch libusb file descriptor %i", fd);
+    }
+}
+
+static void LIBUSB_CALL on_pollfd_removed(int fd, void* user_data)
+{
+    loop_remove(user_data, fd);
+}
+
+/**
+ * @brief Returns the epoll_wait timeout for the next libusb timeout.
+ *
+ * @param loop The loop.
+ * @return int Milliseconds, rounded up, or -1 if there is nothing to wait for.
+ */
+static int usb_timeout_ms(loop_t* loop)
+{
+    if (!loop->usb_attached || !loop->usb_timeouts)
+    {
+        return -1;
+    }
+
+    struct timeval tv;
+    if (libusb_get_next_timeout(loop->usb, &tv) != 1)
+    {
+        return -1;
+    }
+
+    return tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+}
+
+static loop_watch_t* find_watch(loop_t* loop, int fd)
+{
+    for (int i = 0; i < LOOP_MAX_WATCHES; i++)
+    {
+        if (loop->watches[i].handler != NULL && loop->watches[i].fd == fd)
+        {
+            return &loop->watches[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool loop_init(loop_t* loop)
+{
+    memset(loop, 0, sizeof(loop_t));
+    loop->signal_fd = -1;
+    loop->running = true;
+
+    for (int i = 0; i < LOOP_MAX_WATCHES; i++)
+    {
+        loop->watches[i].fd = -1;
+    }
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (loop->epoll_fd < 0)
+    {
+        return false;
+    }
+
+    // Blocked signals are only delivered through the signalfd, so no call of a handler is interrupted.
+    sigset_t mask = loop_signals();
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    loop->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    return loop->signal_fd >= 0 && loop_add(loop, loop->signal_fd, EPOLLIN, on_signal, NULL);
+}
+
+bool loop_add(loop_t* loop, int fd, uint32_t events, loop_handler_t handler, void* user)
+{
+    for (int i = 0; i < LOOP_MAX_WATCHES; i++)
+    {
+        loop_watch_t* watch = &loop->watches[i];
+
+        if (watch->handler != NULL || watch->removed)
+        {
+            continue;
+        }
+
+        struct epoll_event ev = { .events = events, .data.ptr = watch };
+
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            return false;
+        }
+
+        watch->fd = fd;
+        watch->handler = handler;
+        watch->user = user;
+        watch->timer = false;
+
+        return true;
+    }
+
+    return false;
+}
+
+void loop_remove(loop_t* loop, int fd)
+{
+    loop_watch_t* watch = find_watch(loop, fd);
+
+    if (watch == NULL)
+    {
+        return;
+    }
+
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+    watch->fd = -1;
+    watch->handler = NULL;
+    watch->removed = true;
+}
+
+int loop_timer(loop_t* loop, loop_handler_t handler, void* user)
+{
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (timer < 0)
+    {
+        return -1;
+    }
+
+    if (!loop_add(loop, timer, EPOLLIN, handler, user))
+    {
+        close(timer);
+        return -1;
+    }
+
+    find_watch(loop, timer)->timer = true;
+
+    return timer;
+}
+
+void loop_timer_set(int timer, uint64_t delay_ns, uint64_t period_ns)
+{
+    struct itimerspec its = {
+        .it_value = { .tv_sec = delay_ns / NS_PER_SEC, .tv_nsec = delay_ns % NS_PER_SEC },
+        .it_interval = { .tv_sec = period_ns / NS_PER_SEC, .tv_nsec = period_ns % NS_PER_SEC },
+    };
+
+    timerfd_settime(timer, 0, &its, NULL);
+}
+
+uint64_t loop_timer_read(int timer)
+{
+    uint64_t expirations = 0;
+
+    if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        return 0;
+    }
+
+    return expirations;
+}
+
+bool loop_attach_usb(loop_t* loop, libusb_context* ctx)
+{
+    const struct libusb_pollfd** pollfds = libusb_get_pollfds(ctx);
+
+    if (pollfds == NULL)
+    {
+        return false;
+    }
+
+    loop->usb = ctx;
+    loop->usb_attached = true;
+    loop->usb_timeouts = !libusb_pollfds_handle_timeouts(ctx);
+
+    bool ok = true;
+    for (int i = 0; pollfds[i] != NULL; i++)
+    {
+        ok = ok && loop_add(loop, pollfds[i]->fd, pollfds[i]->events, on_usb, NULL);
+    }
+
+    libusb_free_pollfds(pollfds);
+    libusb_set_pollfd_notifiers(ctx, on_pollfd_added, on_pollfd_removed, loop);
+
+    return ok;
+}
+
+void loop_run(loop_t* loop)
+{
+    struct epoll_event events[LOOP_MAX_WATCHES];
+
+    while (loop->running)
+    {
+        int timeout = usb_timeout_ms(loop);
+        int ready = epoll_wait(loop->epoll_fd, events, LOOP_MAX_WATCHES, timeout);
+
+        if (ready < 0)
+        {
+            if (errno != EINTR)
+            {
+                log_error("Error waiting for events - %s", strerror(errno));
+                break;
+            }
+
+            continue;
+        }
+
+        for (int i = 0; i < ready; i++)
+        {
+            loop_watch_t* watch = events[i].data.ptr;
+
+            if (watch->handler != NULL)
+            {
+                watch->handler(loop, watch->fd, events[i].events, watch->user);
+            }
+        }
+
+        for (int i = 0; i < LOOP_MAX_WATCHES; i++)
+        {
+            loop->watches[i].removed = false;
+        }
+
+        // A timeout of libusb expired or one of its pollfds is ready. Completes transfers and runs hotplug callbacks.
+        if (loop->usb_attached && (loop->usb_ready || (ready == 0 && timeout >= 0)))
+        {
+            loop->usb_ready = false;
+
+            struct timeval zero = { 0 };
+            int ret = libusb_handle_events_timeout(loop->usb, &zero);
+
+            if (ret < LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED)
+            {
+                log_error("Error handling USB events - %s", libusb_error_name(ret));
+                break;
+            }
+        }
+    }
+}
+
+void loop_stop(loop_t* loop)
+{
+    loop->running = false;
+}
+
+void loop_free(loop_t* loop)
+{
+    if (loop->usb_attached)
+    {
+        libusb_set_pollfd_notifiers(loop->usb, NULL, NULL, NULL);
+        loop->usb_attached = false;
+    }
+
+    for (int i = 0; i < LOOP_MAX_WATCHES; i++)
+    {
+        if (loop->watches[i].handler != NULL && loop->watches[i].timer)
+        {
+            close(loop->watches[i].fd);
+        }
+    }
+
+    if (loop->signal_fd >= 0)
+    {
+        close(loop->signal_fd);
+    }
+
+    if (loop->epoll_fd >= 0)
+    {
+        close(loop->epoll_fd);
+    }
+}
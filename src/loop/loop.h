@@ -0,0 +1,185 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stdint.h"
+#include "sys/epoll.h"
+
+#include "libusb-1.0/libusb.h"
+
+#define LOOP_MAX_WATCHES 64 // Maximum number of file descriptors watched at once, libusb pollfds included
+
+struct loop;
+
+/**
+ * @brief Called when a watched file descriptor is ready.
+ *
+ * @param loop The loop.
+ * @param fd The ready file descriptor.
+ * @param events Ready events, see epoll_wait.
+ * @param user User data given to loop_add.
+ */
+typedef void (*loop_handler_t)(struct loop* loop, int fd, uint32_t events, void* user);
+
+/**
+ * @brief A watched file descriptor.
+ */
+typedef struct
+{
+    int fd;
+    loop_handler_t handler;
+    void* user;
+
+    /**
+     * @brief Created by loop_timer and closed by loop_free.
+     */
+    bool timer;
+
+    /**
+     * @brief Removed while events were dispatched. The slot is not reused before the dispatch is done, so pending
+     * events of the removed file descriptor are dropped instead of being passed to another handler.
+     */
+    bool removed;
+
+} loop_watch_t;
+
+/**
+ * @brief Single threaded event loop on top of epoll.
+ *
+ * File descriptors, timers (see loop_timer) and the pollfds of libusb (see loop_attach_usb) are waited on at once, so
+ * the process sleeps in epoll_wait until something happens. SIGINT and SIGTERM are read from a signalfd and stop the
+ * loop, handlers are never interrupted by signals.
+ */
+typedef struct loop
+{
+    int epoll_fd;
+    int signal_fd;
+
+    loop_watch_t watches[LOOP_MAX_WATCHES];
+
+    /**
+     * @brief libusb context whose pollfds are watched, see loop_attach_usb.
+     */
+    libusb_context* usb;
+    bool usb_attached;
+
+    /**
+     * @brief libusb needs loop_run to wake up for its timeouts, see libusb_pollfds_handle_timeouts.
+     */
+    bool usb_timeouts;
+
+    /**
+     * @brief A libusb pollfd became ready. libusb handles the events of all its pollfds at once after the dispatch.
+     */
+    bool usb_ready;
+
+    bool running;
+
+} loop_t;
+
+/**
+ * @brief Creates the epoll instance and blocks SIGINT and SIGTERM, which are handled by the loop from now on.
+ *
+ * @param loop The loop.
+ * @return true The loop is ready.
+ */
+bool loop_init(loop_t* loop);
+
+/**
+ * @brief Watches a file descriptor.
+ *
+ * @param loop The loop.
+ * @param fd The file descriptor. Should be non-blocking.
+ * @param events Events to wait for, usually EPOLLIN.
+ * @param handler Called when the file descriptor is ready.
+ * @param user User data passed to the handler.
+ * @return true The file descriptor is watched.
+ */
+bool loop_add(loop_t* loop, int fd, uint32_t events, loop_handler_t handler, void* user);
+
+/**
+ * @brief Stops watching a file descriptor. May be called from a handler. The file descriptor is not closed.
+ *
+ * @param loop The loop.
+ * @param fd The file descriptor.
+ */
+void loop_remove(loop_t* loop, int fd);
+
+/**
+ * @brief Creates a timer and watches it. The handler has to call loop_timer_read.
+ *
+ * @param loop The loop.
+ * @param handler Called when the timer expires.
+ * @param user User data passed to the handler.
+ * @return int The timerfd or -1. Disarmed until loop_timer_set is called.
+ */
+int loop_timer(loop_t* loop, loop_handler_t handler, void* user);
+
+/**
+ * @brief Arms or disarms a timer created with loop_timer.
+ *
+ * @param timer The timerfd.
+ * @param delay_ns Nanoseconds to the first expiration. 0 disarms the timer.
+ * @param period_ns Nanoseconds between the following expirations. 0 for a one-shot timer.
+ */
+void loop_timer_set(int timer, uint64_t delay_ns, uint64_t period_ns);
+
+/**
+ * @brief Acknowledges the expirations of a timer.
+ *
+ * @param timer The timerfd.
+ * @return uint64_t Number of expirations since the last call.
+ */
+uint64_t loop_timer_read(int timer);
+
+/**
+ * @brief Watches the pollfds of the libusb context. Transfers and hotplug callbacks complete from loop_run.
+ *
+ * @param loop The loop.
+ * @param ctx libusb context, NULL for the default context.
+ * @return true The pollfds are watched.
+ */
+bool loop_attach_usb(loop_t* loop, libusb_context* ctx);
+
+/**
+ * @brief Dispatches events until loop_stop is called or a signal is received.
+ *
+ * @param loop The loop.
+ */
+void loop_run(loop_t* loop);
+
+/**
+ * @brief Makes loop_run return after the current events are dispatched. May be called from a handler.
+ *
+ * @param loop The loop.
+ */
+void loop_stop(loop_t* loop);
+
+/**
+ * @brief Detaches libusb and closes the epoll instance. Watched file descriptors are not closed, except for the timers.
+ * SIGINT and SIGTERM stay blocked, so the cleanup after loop_run is not cut short.
+ *
+ * @param loop The loop.
+ */
+void loop_free(loop_t* loop);
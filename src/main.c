@@ -20,7 +20,34 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE. */
 
+#include "stdlib.h"
+
 #include "device/device.h"
+#include "device/hotplug.h"
+#include "device/replay.h"
+#include "daemon/daemon.h"
+#include "command/batch.h"
+#include "effect/fade.h"
+#include "effect/reactive.h"
+#include "effect/animation.h"
+#include "effect/video.h"
+#include "shm/shm.h"
+#include "profile/profile.h"
+#include "log/log.h"
+#include "stats/stats.h"
+
+/**
+ * @brief Returns whether the lighting may be forwarded to a running daemon. The daemon only receives the lighting, so
+ * options selecting the device or changing how the lighting is sent have to be applied by this process.
+ *
+ * @param args Application arguments.
+ * @return true No such option is given.
+ */
+static bool use_daemon(const args_t* args)
+{
+    return args->transport == TRANSPORT_LIBUSB && args->record_path == NULL && !args->correction.enabled && !args->force
+        && args->vendor_id == -1 && args->product_id == -1;
+}
 
 int main(int argc, char** argv)
 {
@@ -29,7 +56,104 @@ int main(int argc, char** argv)
 
     args_parse(argc, argv, &args);
 
-    device_set_lighting(&args);
+    // Registered before the logger, so the statistics are written after the log is flushed.
+    stats_enable(args.stats_format, args.stats_path);
+
+    log_set_level(args.log_level);
+    log_start();
+
+    if (args.daemon)
+    {
+        daemon_run(&args);
+        return 0;
+    }
+
+    if (args.replay_path != NULL)
+    {
+        replay_run(&args);
+        return 0;
+    }
+
+    if (args.compile_path != NULL)
+    {
+        return profile_compile_run(&args);
+    }
+
+    if (args.profile != NULL)
+    {
+        return profile_apply_run(&args);
+    }
+
+    if (args.encode_path != NULL)
+    {
+        return animation_encode_run(&args);
+    }
+
+    if (args.animation_path != NULL)
+    {
+        return animation_play_run(&args);
+    }
+
+    if (args.video_path != NULL)
+    {
+        return video_run(&args);
+    }
+
+    if (args.shm)
+    {
+        return shm_run(&args);
+    }
+
+    if (args.batch_path != NULL)
+    {
+        return batch_run(&args);
+    }
+
+    if (args.watch)
+    {
+        hotplug_run(&args);
+        return 0;
+    }
+
+    if (args.react != NULL || args.bench)
+    {
+        reactive_run(&args);
+        return 0;
+    }
+
+    if (args.fade_ms > 0)
+    {
+        fade_run(&args);
+        return 0;
+    }
+
+    if (args.all)
+    {
+        device_set_lighting_all(&args);
+        return 0;
+    }
+
+    if (!use_daemon(&args))
+    {
+        device_set_lighting(&args);
+        return 0;
+    }
+
+    lighting_t lighting;
+    args_to_lighting(&args, &lighting);
+
+    switch (daemon_send(&args, &lighting))
+    {
+    case DAEMON_APPLIED:
+        return 0;
+
+    case DAEMON_FAILED:
+        return EXIT_FAILURE;
+
+    case DAEMON_NOT_RUNNING:
+        device_set_lighting(&args);
+        break;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,409 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "limits.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+
+#include "profile.h"
+#include "../command/command.h"
+#include "../log/log.h"
+
+#define PROFILE_DIR_NAME "cherrymxboard30s-rgb/profiles"
+
+_Static_assert(sizeof(profile_header_t) == TRANSPORT_REPORT_LEN, "profile header must be one report long");
+
+/**
+ * @brief Determines the profile directory, $XDG_DATA_HOME or ~/.local/share.
+ *
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ * @return true The directory could be determined.
+ */
+static bool profile_dir(char* into, size_t len)
+{
+    const char* xdg = getenv("XDG_DATA_HOME");
+    int written;
+
+    if (xdg != NULL && xdg[0] != '\0')
+    {
+        written = snprintf(into, len, "%s/" PROFILE_DIR_NAME, xdg);
+    }
+    else
+    {
+        const char* home = getenv("HOME");
+
+        if (home == NULL || home[0] == '\0')
+        {
+            return false;
+        }
+
+        written = snprintf(into, len, "%s/.local/share/" PROFILE_DIR_NAME, home);
+    }
+
+    return written > 0 && (size_t)written < len;
+}
+
+/**
+ * @brief Creates the given directory and all of its parents.
+ *
+ * @param dir The directory. Modified temporarily.
+ * @return true The directory exists.
+ */
+static bool make_dirs(char* dir)
+{
+    for (char* slash = strchr(dir + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
+    {
+        *slash = '\0';
+        mkdir(dir, 0700);
+        *slash = '/';
+    }
+
+    return mkdir(dir, 0700) == 0 || errno == EEXIST;
+}
+
+/**
+ * @brief Resolves a profile name. Names containing a '/' are paths, all others are looked up in the profile
+ * directory and get PROFILE_EXTENSION appended if missing.
+ *
+ * @param name Name or path of the profile.
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ * @return true The path could be determined.
+ */
+static bool profile_path(const char* name, char* into, size_t len)
+{
+    if (strchr(name, '/') != NULL)
+    {
+        return (size_t)snprintf(into, len, "%s", name) < len;
+    }
+
+    char dir[PATH_MAX];
+
+    if (!profile_dir(dir, sizeof(dir)))
+    {
+        return false;
+    }
+
+    size_t name_len = strlen(name);
+    size_t ext_len = strlen(PROFILE_EXTENSION);
+    bool has_ext = name_len > ext_len && strcmp(name + name_len - ext_len, PROFILE_EXTENSION) == 0;
+
+    int written = snprintf(into, len, "%s/%s%s", dir, name, has_ext ? "" : PROFILE_EXTENSION);
+
+    return written > 0 && (size_t)written < len;
+}
+
+/**
+ * @brief Determines the output path of a compiled profile. Without an explicit output the base name of the
+ * source without its extension is used as profile name.
+ *
+ * @param args Application arguments.
+ * @param into Output buffer.
+ * @param len Size of the output buffer.
+ * @return true The path could be determined.
+ */
+static bool output_path(const args_t* args, char* into, size_t len)
+{
+    if (args->output_path != NULL)
+    {
+        return (size_t)snprintf(into, len, "%s", args->output_path) < len;
+    }
+
+    const char* base = strrchr(args->compile_path, '/');
+    base = base != NULL ? base + 1 : args->compile_path;
+
+    char name[NAME_MAX + 1];
+    snprintf(name, sizeof(name), "%s", base);
+
+    char* dot = strrchr(name, '.');
+    if (dot != NULL && dot != name)
+    {
+        *dot = '\0';
+    }
+
+    return profile_path(name, into, len);
+}
+
+/**
+ * @brief Checks if the command would wait. Profiles are applied at once, so delays cannot be compiled.
+ *
+ * @param line The command.
+ * @return true The command is a delay.
+ */
+static bool is_delay(const char* line)
+{
+    line += strspn(line, " \t");
+
+    return strncmp(line, "delay", 5) == 0 && (line[5] == '\0' || strchr(" \t\r\n", line[5]) != NULL);
+}
+
+/**
+ * @brief Executes the commands of the source on the given device, see command_execute.
+ *
+ * @param file The source.
+ * @param transport The opened device.
+ * @return int Number of failed lines.
+ */
+static int execute_source(FILE* file, transport_t* transport)
+{
+    command_session_t session;
+    command_session_init(&session, transport);
+
+    char* line = NULL;
+    size_t len = 0;
+    int lineno = 0;
+    int failed = 0;
+
+    while (getline(&line, &len, file) != -1)
+    {
+        lineno++;
+
+        if (is_delay(line))
+        {
+            log_error("Line %i: Profiles cannot contain delays", lineno);
+            failed++;
+            continue;
+        }
+
+        int ret = command_execute(&session, line);
+
+        if (ret == LIBUSB_ERROR_INVALID_PARAM)
+        {
+            log_error("Invalid command in line %i: %s", lineno, strtok(line, "\r\n"));
+            failed++;
+        }
+        else if (ret == LIBUSB_ERROR_NOT_SUPPORTED)
+        {
+            log_error("Line %i: Per key colors need CUSTOM lighting", lineno);
+            failed++;
+        }
+        else if (ret < LIBUSB_SUCCESS)
+        {
+            failed++;
+        }
+    }
+
+    free(line);
+
+    return failed;
+}
+
+/**
+ * @brief Writes the header and the reports received by the mock device. The file is replaced atomically.
+ *
+ * @param path Path of the compiled profile.
+ * @param header The header.
+ * @param transport The mock device holding the reports.
+ * @return true The profile was written.
+ */
+static bool write_profile(const char* path, const profile_header_t* header, const transport_t* transport)
+{
+    char tmp[PATH_MAX + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* file = fopen(tmp, "wb");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    bool ok = fwrite(header, sizeof(profile_header_t), 1, file) == 1;
+
+    uint8_t report[TRANSPORT_REPORT_LEN];
+
+    for (uint32_t i = 0; ok && i < header->count; i++)
+    {
+        ok = transport_mock_report(transport, i, report) && fwrite(report, sizeof(report), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0 || !ok || rename(tmp, path) != 0)
+    {
+        remove(tmp);
+        return false;
+    }
+
+    return true;
+}
+
+int profile_compile_run(args_t* args)
+{
+    FILE* file = fopen(args->compile_path, "r");
+
+    if (file == NULL)
+    {
+        log_error("Error opening %s - %s - Abort.\n", args->compile_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    char path[PATH_MAX];
+
+    if (!output_path(args, path, sizeof(path)))
+    {
+        log_error("Cannot determine the profile path, use --output - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The commands are encoded exactly like for the real device and captured by the mock device.
+    transport_t transport;
+    mock_config_t config = { 0, 0, LIBUSB_SUCCESS, true };
+
+    if (transport_mock_open(&transport, &config) < LIBUSB_SUCCESS)
+    {
+        log_error("Error creating mock device - Abort.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    transport.vendor_id = args->vendor_id != -1 ? args->vendor_id : DEFAULT_VENDOR_ID;
+    transport.product_id = args->product_id != -1 ? args->product_id : DEFAULT_PRODUCT_ID;
+    transport.correction = args->correction.enabled ? &args->correction : NULL;
+
+    int failed = execute_source(file, &transport);
+    fclose(file);
+
+    if (failed > 0)
+    {
+        log_error("%i invalid lines in %s - Abort.\n", failed, args->compile_path);
+        transport_close(&transport);
+        return EXIT_FAILURE;
+    }
+
+    profile_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROFILE_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_VERSION;
+    header.vendor_id = transport.vendor_id;
+    header.product_id = transport.product_id;
+    header.count = transport_mock_count(&transport);
+    header.correction_id = args->correction.enabled ? args->correction.id : 0;
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+
+    char* slash = strrchr(dir, '/');
+    if (slash != NULL && slash != dir)
+    {
+        *slash = '\0';
+        make_dirs(dir);
+    }
+
+    bool written = write_profile(path, &header, &transport);
+    transport_close(&transport);
+
+    if (!written)
+    {
+        log_error("Error writing %s - %s - Abort.\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (args->verbose)
+    {
+        log_info("Compiled %u reports to %s", header.count, path);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int profile_apply_run(args_t* args)
+{
+    char path[PATH_MAX];
+
+    if (!profile_path(args->profile, path, sizeof(path)))
+    {
+        log_error("Cannot determine the path of profile %s - Abort.\n", args->profile);
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        log_error("Error opening %s - %s - Abort.\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(profile_header_t))
+    {
+        log_error("%s is not a compiled profile - Abort.\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    // The reports are sent straight from the mapping, MAP_POPULATE avoids page faults while sending.
+    const uint8_t* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        log_error("Error mapping %s - %s - Abort.\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    const profile_header_t* header = (const profile_header_t*)data;
+
+    if (memcmp(header->magic, PROFILE_MAGIC, sizeof(header->magic)) != 0 || header->version != PROFILE_VERSION
+        || (size_t)st.st_size != sizeof(profile_header_t) + (size_t)header->count * TRANSPORT_REPORT_LEN)
+    {
+        log_error("%s is not a compiled profile of version %i - Abort.\n", path, PROFILE_VERSION);
+        exit(EXIT_FAILURE);
+    }
+
+    if (args->correction.enabled && header->correction_id != args->correction.id)
+    {
+        log_error("%s was compiled with a different color correction, compile it again - Abort.\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    int ret = LIBUSB_SUCCESS;
+
+    if (header->vendor_id != transport.vendor_id || header->product_id != transport.product_id)
+    {
+        log_error("%s was compiled for %04x:%04x, but the device is %04x:%04x.\n", path,
+            header->vendor_id, header->product_id, transport.vendor_id, transport.product_id);
+        ret = LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+    else
+    {
+        ret = transport_send_many(&transport, data + sizeof(profile_header_t), header->count);
+    }
+
+    if (args->verbose && ret >= LIBUSB_SUCCESS)
+    {
+        log_info("Applied %u reports of %s", header->count, path);
+    }
+
+    munmap((void*)data, st.st_size);
+    device_disconnect(&transport);
+
+    return ret >= LIBUSB_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
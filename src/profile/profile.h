@@ -0,0 +1,80 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+
+#include "../args/args.h"
+
+#define PROFILE_MAGIC "CMXPROF"
+#define PROFILE_VERSION 1
+#define PROFILE_EXTENSION ".prof"
+
+/**
+ * @brief Header of a compiled profile. Followed by count reports of TRANSPORT_REPORT_LEN bytes, so the
+ * reports start at the same alignment as the header.
+ */
+typedef struct
+{
+    /**
+     * @brief PROFILE_MAGIC including the terminating zero.
+     */
+    char magic[8];
+
+    uint32_t version;
+
+    /**
+     * @brief Ids of the device the reports were encoded for.
+     */
+    uint16_t vendor_id;
+    uint16_t product_id;
+
+    /**
+     * @brief Number of reports following the header.
+     */
+    uint32_t count;
+
+    /**
+     * @brief Id of the color correction baked into the reports, 0 if none.
+     */
+    uint32_t correction_id;
+
+    uint8_t reserved[40];
+
+} profile_header_t;
+
+/**
+ * @brief Compiles the profile source in args into ready to send reports, see profile_compile.
+ *
+ * @param args Application arguments.
+ * @return int EXIT_SUCCESS if the profile was written.
+ */
+int profile_compile_run(args_t* args);
+
+/**
+ * @brief Maps the compiled profile in args and sends its reports to the device without any encoding.
+ *
+ * @param args Application arguments.
+ * @return int EXIT_SUCCESS if all reports were sent.
+ */
+int profile_apply_run(args_t* args);
@@ -0,0 +1,190 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "signal.h"
+#include "time.h"
+#include "sys/stat.h"
+
+#include "shm.h"
+#include "shm_ring.h"
+#include "../device/device.h"
+#include "../device/sender.h"
+#include "../effect/fade.h"
+#include "../log/log.h"
+
+_Static_assert(sizeof(frame_t) == SHM_RING_KEYS * 3, "frames are copied from the ring as they are");
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    running = 0;
+}
+
+/**
+ * @brief Creates the ring, replacing a ring left behind by a previous run. The ring is always a new object, so a
+ * segment of another process or user is never reused.
+ *
+ * @param name Name of the shared memory object.
+ * @return shm_ring_t* The ring or NULL on errors, errno is set.
+ */
+static shm_ring_t* create_ring(const char* name)
+{
+    // Fails for objects of other users, which O_EXCL then refuses.
+    shm_unlink(name);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(shm_ring_t)) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    shm_ring_t* ring = mmap(NULL, sizeof(shm_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ring == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    memset(ring, 0, sizeof(shm_ring_t));
+    ring->version = SHM_RING_VERSION;
+    ring->keys = SHM_RING_KEYS;
+    ring->slots = SHM_RING_SLOTS;
+
+    // Producers check the magic first, so it is written last.
+    atomic_thread_fence(memory_order_release);
+    ring->magic = SHM_RING_MAGIC;
+
+    return ring;
+}
+
+int shm_run(args_t* args)
+{
+    shm_ring_t* ring = create_ring(args->shm_name);
+
+    if (ring == NULL)
+    {
+        log_error("Error creating shared memory %s - %s - Abort.\n", args->shm_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    transport_t transport;
+    device_connect(args, &transport);
+
+    lighting_t lighting;
+    args_to_lighting(args, &lighting);
+    lighting.mode = CUSTOM;
+    lighting.red = lighting.green = lighting.blue = 0;
+
+    if (device_apply_lighting(lighting, &transport) < LIBUSB_SUCCESS)
+    {
+        shm_unlink(args->shm_name);
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    log_info("Waiting for frames in shared memory %s", args->shm_name);
+
+    unsigned int fps = args->fps > 0 ? args->fps : FADE_DEFAULT_FPS;
+    fps = fps > FADE_MAX_FPS ? FADE_MAX_FPS : fps;
+
+    pacing_t pacing;
+    pacing_init(&pacing, args->target_latency_us, fps, args->verbose);
+
+    sender_t sender;
+
+    if (!sender_start(&sender, &transport, args->target_latency_us > 0 ? &pacing : NULL, NULL, NULL))
+    {
+        log_error("Error starting the sending thread - Abort.\n");
+        shm_unlink(args->shm_name);
+        device_disconnect(&transport);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t seen = 0;
+    unsigned long skipped = 0;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (running && sender_error(&sender) == LIBUSB_SUCCESS)
+    {
+        uint64_t previous = seen;
+        mailbox_slot_t* slot = sender_frame(&sender);
+
+        // Copies straight into the frame handed to the sending thread, the producer never waits for this.
+        if (shm_ring_read(ring, &seen, (uint8_t*)slot->frame.keys))
+        {
+            skipped += seen - previous - 1;
+            slot->stamp = 0;
+
+            sender_submit(&sender);
+        }
+
+        deadline.tv_nsec += 1000000000L / pacing_fps(sender.pacing, fps);
+
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+
+        // Falling behind moves the schedule instead of polling repeatedly to catch up.
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec > deadline.tv_nsec))
+        {
+            deadline = now;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+
+    int ret = sender_stop(&sender);
+
+    log_info("Shared memory closed - %lu frames sent, %lu skipped, %lu dropped by the device", sender.sent, skipped,
+        sender.mailbox.dropped);
+
+    shm_unlink(args->shm_name);
+    munmap(ring, sizeof(shm_ring_t));
+    device_disconnect(&transport);
+
+    return ret >= LIBUSB_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
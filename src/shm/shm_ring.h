@@ -0,0 +1,215 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+/*
+ * Shared memory interface for programs that drive the per key colors, see --shm.
+ *
+ * cherrymxboard30s-rgb --shm creates the ring and sends the newest published frame to the keyboard. Producers attach
+ * to the ring, fill the buffer returned by shm_ring_begin and publish it with shm_ring_publish. Neither needs a system
+ * call, so frames can be published at any rate. Only one producer may publish to a ring at a time.
+ *
+ * This header is self-contained and installed for external programs. Link with -lrt on glibc older than 2.34.
+ */
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "string.h"
+#include "stdatomic.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+
+#define SHM_RING_NAME "/cherrymxboard30s-rgb" // Default name of the ring, see shm_open
+#define SHM_RING_MAGIC 0x4d524758             // "XGRM"
+#define SHM_RING_VERSION 1
+
+/**
+ * @brief Number of keys per frame. The color of the key in LED matrix row r and column c is at index r * 21 + c.
+ */
+#define SHM_RING_KEYS 126
+
+/**
+ * @brief Number of frame slots. Reading the newest frame is only retried if the producer publishes this many frames
+ * while it is copied.
+ */
+#define SHM_RING_SLOTS 4
+
+/**
+ * @brief Attempts of shm_ring_read to copy a frame that is not overwritten meanwhile. The frame is taken on a later
+ * call if all attempts fail.
+ */
+#define SHM_RING_READ_ATTEMPTS 8
+
+/**
+ * @brief A frame slot, guarded by a sequence counter that is odd while the slot is written.
+ */
+typedef struct
+{
+    _Atomic uint32_t sequence;
+
+    /**
+     * @brief Red, green and blue of every key.
+     */
+    uint8_t rgb[SHM_RING_KEYS * 3];
+
+} __attribute__((aligned(64))) shm_ring_slot_t;
+
+/**
+ * @brief Layout of the shared memory object.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keys;
+    uint32_t slots;
+
+    /**
+     * @brief Number of published frames. The newest frame is in slot (head - 1) % SHM_RING_SLOTS.
+     */
+    _Atomic uint64_t head;
+
+    shm_ring_slot_t slot[SHM_RING_SLOTS];
+
+} shm_ring_t;
+
+/**
+ * @brief Maps the ring created by cherrymxboard30s-rgb --shm.
+ *
+ * @param name Name of the ring, SHM_RING_NAME unless --shm was given another name.
+ * @return shm_ring_t* The ring or NULL if it does not exist or is incompatible.
+ */
+static inline shm_ring_t* shm_ring_attach(const char* name)
+{
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    void* ring = mmap(NULL, sizeof(shm_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ring == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    const shm_ring_t* header = (const shm_ring_t*)ring;
+
+    if (header->magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION || header->keys != SHM_RING_KEYS
+        || header->slots != SHM_RING_SLOTS)
+    {
+        munmap(ring, sizeof(shm_ring_t));
+        return NULL;
+    }
+
+    return (shm_ring_t*)ring;
+}
+
+/**
+ * @brief Unmaps the ring.
+ *
+ * @param ring The ring.
+ */
+static inline void shm_ring_detach(shm_ring_t* ring)
+{
+    munmap(ring, sizeof(shm_ring_t));
+}
+
+/**
+ * @brief Starts writing the next frame. The returned buffer holds an older frame and must be filled completely.
+ *
+ * @param ring The ring.
+ * @return uint8_t* SHM_RING_KEYS * 3 bytes of red, green and blue.
+ */
+static inline uint8_t* shm_ring_begin(shm_ring_t* ring)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    shm_ring_slot_t* slot = &ring->slot[head % SHM_RING_SLOTS];
+
+    // Set odd explicitly, a producer that exited between begin and publish left the slot odd already.
+    uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence | 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    return slot->rgb;
+}
+
+/**
+ * @brief Publishes the frame written after shm_ring_begin.
+ *
+ * @param ring The ring.
+ */
+static inline void shm_ring_publish(shm_ring_t* ring)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    shm_ring_slot_t* slot = &ring->slot[head % SHM_RING_SLOTS];
+
+    uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, (sequence | 1) + 1, memory_order_release);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Copies the newest frame if it is newer than the one seen before. Used by cherrymxboard30s-rgb.
+ *
+ * @param ring The ring.
+ * @param seen Number of published frames at the last call, updated if a frame was copied.
+ * @param rgb Receives SHM_RING_KEYS * 3 bytes of red, green and blue.
+ * @return true A newer frame was copied, false if there is none or it was overwritten on every attempt.
+ */
+static inline bool shm_ring_read(const shm_ring_t* ring, uint64_t* seen, uint8_t* rgb)
+{
+    for (int attempt = 0; attempt < SHM_RING_READ_ATTEMPTS; attempt++)
+    {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if (head == *seen)
+        {
+            return false;
+        }
+
+        const shm_ring_slot_t* slot = &ring->slot[(head - 1) % SHM_RING_SLOTS];
+        uint32_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+        // Odd while the producer writes the slot, it lapped the reader and the newest frame is elsewhere by now.
+        if ((before & 1) != 0)
+        {
+            continue;
+        }
+
+        memcpy(rgb, slot->rgb, SHM_RING_KEYS * 3);
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == before)
+        {
+            *seen = head;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,253 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "strings.h"
+#include "time.h"
+#include "stdatomic.h"
+
+#include "stats.h"
+#include "../log/log.h"
+
+#define STATS_PREFIX "cherrymxboard30s_rgb_"
+
+static const char* PHASE_NAMES[STATS_PHASE_COUNT] = {
+    "setup",
+    "enumerate",
+    "descriptors",
+    "open",
+    "claim",
+    "transfer",
+    "cleanup",
+};
+
+/**
+ * @brief Accumulated time of a phase.
+ */
+typedef struct
+{
+    /**
+     * @brief How often the phase was entered.
+     */
+    atomic_uint_fast64_t count;
+
+    /**
+     * @brief Total time spent in the phase in nanoseconds.
+     */
+    atomic_uint_fast64_t ns;
+
+} phase_t;
+
+static phase_t phases[STATS_PHASE_COUNT];
+
+static atomic_uint_fast64_t transfers;
+static atomic_uint_fast64_t transfer_errors;
+static atomic_uint_fast64_t transfer_bytes;
+
+static uint64_t started;
+static STATS_FORMAT export_format;
+static const char* export_path;
+
+uint64_t stats_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void stats_phase_end(STATS_PHASE phase, uint64_t start)
+{
+    if (phase >= STATS_PHASE_COUNT)
+        return;
+
+    atomic_fetch_add_explicit(&phases[phase].count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&phases[phase].ns, stats_now() - start, memory_order_relaxed);
+}
+
+void stats_transfer(int reports, int bytes, bool ok)
+{
+    atomic_fetch_add_explicit(&transfers, reports, memory_order_relaxed);
+
+    if (ok)
+    {
+        atomic_fetch_add_explicit(&transfer_bytes, bytes, memory_order_relaxed);
+    }
+    else
+    {
+        atomic_fetch_add_explicit(&transfer_errors, 1, memory_order_relaxed);
+    }
+}
+
+bool stats_format_parse(const char* name, STATS_FORMAT* format)
+{
+    if (!name || !format)
+        return false;
+
+    if (strcasecmp(name, "json") == 0)
+    {
+        *format = STATS_FORMAT_JSON;
+        return true;
+    }
+
+    if (strcasecmp(name, "prometheus") == 0)
+    {
+        *format = STATS_FORMAT_PROMETHEUS;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Converts nanoseconds to seconds.
+ */
+static double seconds(uint64_t ns)
+{
+    return ns / 1e9;
+}
+
+/**
+ * @brief Writes the statistics as a single JSON object.
+ */
+static void write_json(FILE* out, uint64_t runtime)
+{
+    fprintf(out, "{\"runtime_seconds\":%.9f,\"phases\":{", seconds(runtime));
+
+    for (int i = 0; i < STATS_PHASE_COUNT; i++)
+    {
+        fprintf(out, "%s\"%s\":{\"count\":%lu,\"seconds\":%.9f}",
+                i > 0 ? "," : "",
+                PHASE_NAMES[i],
+                (unsigned long)atomic_load(&phases[i].count),
+                seconds(atomic_load(&phases[i].ns)));
+    }
+
+    fprintf(out, "},\"transfers\":{\"reports\":%lu,\"errors\":%lu,\"bytes\":%lu}}\n",
+            (unsigned long)atomic_load(&transfers),
+            (unsigned long)atomic_load(&transfer_errors),
+            (unsigned long)atomic_load(&transfer_bytes));
+}
+
+/**
+ * @brief Writes the statistics in the Prometheus text format.
+ */
+static void write_prometheus(FILE* out, uint64_t runtime)
+{
+    fprintf(out, "# HELP " STATS_PREFIX "phase_seconds_total Time spent in each phase.\n");
+    fprintf(out, "# TYPE " STATS_PREFIX "phase_seconds_total counter\n");
+
+    for (int i = 0; i < STATS_PHASE_COUNT; i++)
+    {
+        fprintf(out, STATS_PREFIX "phase_seconds_total{phase=\"%s\"} %.9f\n", PHASE_NAMES[i], seconds(atomic_load(&phases[i].ns)));
+    }
+
+    fprintf(out, "# HELP " STATS_PREFIX "phase_calls_total Number of times each phase was entered.\n");
+    fprintf(out, "# TYPE " STATS_PREFIX "phase_calls_total counter\n");
+
+    for (int i = 0; i < STATS_PHASE_COUNT; i++)
+    {
+        fprintf(out, STATS_PREFIX "phase_calls_total{phase=\"%s\"} %lu\n", PHASE_NAMES[i], (unsigned long)atomic_load(&phases[i].count));
+    }
+
+    fprintf(out, "# HELP " STATS_PREFIX "reports_total Number of reports sent.\n");
+    fprintf(out, "# TYPE " STATS_PREFIX "reports_total counter\n");
+    fprintf(out, STATS_PREFIX "reports_total %lu\n", (unsigned long)atomic_load(&transfers));
+
+    fprintf(out, "# HELP " STATS_PREFIX "transfer_errors_total Number of failed transfers.\n");
+    fprintf(out, "# TYPE " STATS_PREFIX "transfer_errors_total counter\n");
+    fprintf(out, STATS_PREFIX "transfer_errors_total %lu\n", (unsigned long)atomic_load(&transfer_errors));
+
+    fprintf(out, "# HELP " STATS_PREFIX "transfer_bytes_total Number of bytes sent.\n");
+    fprintf(out, "# TYPE " STATS_PREFIX "transfer_bytes_total counter\n");
+    fprintf(out, STATS_PREFIX "transfer_bytes_total %lu\n", (unsigned long)atomic_load(&transfer_bytes));
+
+    fprintf(out, "# HELP " STATS_PREFIX "runtime_seconds Duration of the run.\n");
+    fprintf(out, "# TYPE " STATS_PREFIX "runtime_seconds gauge\n");
+    fprintf(out, STATS_PREFIX "runtime_seconds %.9f\n", seconds(runtime));
+}
+
+bool stats_write(STATS_FORMAT format, const char* path)
+{
+    uint64_t runtime = started > 0 ? stats_now() - started : 0;
+
+    if (path == NULL || strcmp(path, "-") == 0)
+    {
+        if (format == STATS_FORMAT_JSON)
+            write_json(stdout, runtime);
+        else
+            write_prometheus(stdout, runtime);
+
+        fflush(stdout);
+        return true;
+    }
+
+    // Written to a temporary file first, so readers never see a partial file.
+    char tmp[strlen(path) + 5];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* out = fopen(tmp, "w");
+
+    if (out == NULL)
+    {
+        return false;
+    }
+
+    if (format == STATS_FORMAT_JSON)
+        write_json(out, runtime);
+    else
+        write_prometheus(out, runtime);
+
+    if (fclose(out) != 0 || rename(tmp, path) != 0)
+    {
+        remove(tmp);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes the statistics configured by stats_enable.
+ */
+static void write_at_exit()
+{
+    if (!stats_write(export_format, export_path))
+    {
+        log_error("Error writing statistics to %s", export_path);
+    }
+}
+
+void stats_enable(STATS_FORMAT format, const char* path)
+{
+    started = stats_now();
+
+    if (format == STATS_FORMAT_NONE || export_format != STATS_FORMAT_NONE)
+        return;
+
+    export_format = format;
+    export_path = path;
+
+    atexit(write_at_exit);
+}
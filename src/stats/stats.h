@@ -0,0 +1,105 @@
+/* MIT License
+
+Copyright (c) 2022 Lukas Pfeifer
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#pragma once
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/**
+ * @brief Phases of a run that are timed.
+ */
+typedef enum
+{
+    STATS_PHASE_SETUP = 0,       // libusb_init
+    STATS_PHASE_ENUMERATE = 1,   // libusb_get_device_list
+    STATS_PHASE_DESCRIPTORS = 2, // Reading the device descriptors of all devices
+    STATS_PHASE_OPEN = 3,        // libusb_open or opening the hidraw or mock device
+    STATS_PHASE_CLAIM = 4,       // Claiming all interfaces
+    STATS_PHASE_TRANSFER = 5,    // Sending reports
+    STATS_PHASE_CLEANUP = 6,     // Releasing the interfaces, closing the device and libusb_exit
+    STATS_PHASE_COUNT = 7
+
+} STATS_PHASE;
+
+/**
+ * @brief Export format of the statistics.
+ */
+typedef enum
+{
+    STATS_FORMAT_NONE = 0,
+    STATS_FORMAT_JSON = 1,
+    STATS_FORMAT_PROMETHEUS = 2
+
+} STATS_FORMAT;
+
+/**
+ * @brief Returns the current time of the monotonic clock.
+ *
+ * @return uint64_t Nanoseconds.
+ */
+uint64_t stats_now();
+
+/**
+ * @brief Adds the time since start to the given phase.
+ *
+ * @param phase The phase.
+ * @param start Start of the phase, see stats_now.
+ */
+void stats_phase_end(STATS_PHASE phase, uint64_t start);
+
+/**
+ * @brief Counts sent reports.
+ *
+ * @param reports Number of reports.
+ * @param bytes Number of bytes.
+ * @param ok false if the transfer failed.
+ */
+void stats_transfer(int reports, int bytes, bool ok);
+
+/**
+ * @brief Parses the name of an export format.
+ *
+ * @param name json or prometheus.
+ * @param format Receives the format.
+ * @return true The name is valid.
+ * @return false The name is invalid.
+ */
+bool stats_format_parse(const char* name, STATS_FORMAT* format);
+
+/**
+ * @brief Writes the statistics at exit.
+ *
+ * @param format The export format. STATS_FORMAT_NONE disables the export.
+ * @param path The file to write or NULL for stdout. The file is replaced atomically.
+ */
+void stats_enable(STATS_FORMAT format, const char* path);
+
+/**
+ * @brief Writes the statistics.
+ *
+ * @param format The export format.
+ * @param path The file to write or NULL for stdout. The file is replaced atomically.
+ * @return true The statistics were written.
+ * @return false The file could not be written.
+ */
+bool stats_write(STATS_FORMAT format, const char* path);
@@ -0,0 +1,34 @@
+# Runs the program against the mock device and compares the recorded reports with a golden recording.
+#
+# cmake -DPROGRAM=... -DRECORD=... -DGOLDEN=... "-DARGS=-l;WAVE" -P golden.cmake
+#
+# The timestamps of the recording are not compared. UPDATE=ON writes the reports to the golden recording instead.
+
+execute_process(
+    COMMAND ${PROGRAM} --transport mock --record ${RECORD} ${ARGS}
+    RESULT_VARIABLE result
+    OUTPUT_QUIET)
+
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${PROGRAM} ${ARGS} failed with ${result}")
+endif()
+
+file(STRINGS ${RECORD} lines)
+
+set(reports "")
+foreach(line IN LISTS lines)
+    string(REGEX REPLACE "^[0-9]+ " "" report "${line}")
+    string(APPEND reports "${report}\n")
+endforeach()
+
+if(UPDATE)
+    file(WRITE ${GOLDEN} "${reports}")
+    return()
+endif()
+
+file(READ ${GOLDEN} expected)
+
+if(NOT reports STREQUAL expected)
+    file(WRITE ${RECORD}.reports "${reports}")
+    message(FATAL_ERROR "Reports differ from ${GOLDEN}, see ${RECORD}.reports")
+endif()